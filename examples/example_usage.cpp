@@ -228,6 +228,22 @@ void example_image_processing() {
               << (result.items_processed / (result.execution_time_ms / 1000.0) / 1000000.0)
               << " megapixels/sec\n";
     std::cout << "Threads utilized: " << result.threads_used << "\n";
+
+    // Same filter as a batch kernel: one call per chunk instead of per pixel
+    auto batch = declarative::process_batch<Pixel>(
+        image,
+        config,
+        [](declarative::Span<const Pixel> in, declarative::Span<Pixel> out) {
+            for (size_t i = 0; i < in.size(); ++i) {
+                uint8_t gray = static_cast<uint8_t>(
+                    (77 * in[i].r + 150 * in[i].g + 29 * in[i].b) >> 8
+                );
+                out[i] = {gray, gray, gray};
+            }
+        }
+    );
+
+    std::cout << "Batch kernel applied in " << batch.execution_time_ms << " ms\n";
 }
 
 // ============================================================================
@@ -305,6 +321,39 @@ void example_error_handling() {
     }
 }
 
+// ============================================================================
+// EXAMPLE 8: Nested Task Groups on a Small Lock-Free Queue
+// ============================================================================
+
+bool example_nested_groups() {
+    std::cout << "\n=== EXAMPLE 8: Nested Task Groups on a Small Lock-Free Queue ===\n\n";
+    
+    // A tiny ring fills up immediately; workers submitting to it run the
+    // overflow inline instead of spinning on their own queue
+    declarative::ThreadPoolConfig pool_config;
+    pool_config.threads = 6;
+    pool_config.submission = declarative::SubmissionQueue::LockFree;
+    pool_config.queue_capacity = 8;
+    pool_config.backpressure = declarative::BackpressurePolicy::Spin;
+    declarative::ThreadPool pool(pool_config);
+    
+    std::atomic<int> leaves{0};
+    declarative::TaskGroup outer(pool);
+    for (int i = 0; i < 20; ++i) {
+        outer.run([&] {
+            declarative::TaskGroup inner(pool);
+            for (int j = 0; j < 20; ++j) {
+                inner.run([&] { leaves.fetch_add(1); });
+            }
+            inner.wait();
+        });
+    }
+    outer.wait();
+    
+    std::cout << "Leaf tasks run: " << leaves.load() << " / 400\n";
+    return leaves.load() == 400;
+}
+
 // ============================================================================
 // MAIN
 // ============================================================================
@@ -327,6 +376,11 @@ int main() {
         example_benchmark();
         example_error_handling();
         
+        if (!example_nested_groups()) {
+            std::cerr << "\n❌ Nested task groups lost tasks\n";
+            return 1;
+        }
+        
     } catch (const std::exception& e) {
         std::cerr << "\n❌ Fatal error: " << e.what() << "\n";
         return 1;
@@ -35,6 +35,44 @@
 #include <chrono>
 #include <optional>
 #include <type_traits>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <limits>
+#include <iterator>
+#include <utility>
+#include <stdexcept>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#include <cctype>
+#include <map>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+// Define DECLARATIVE_COMPUTE_USE_LIBNUMA (and link -lnuma) to look up which
+// NUMA node input pages live on; without it, NUMA mode assumes input is
+// spread over the nodes in address order.
+#if defined(DECLARATIVE_COMPUTE_USE_LIBNUMA) && defined(__linux__)
+#if __has_include(<numaif.h>)
+#include <numaif.h>
+#define DECLARATIVE_COMPUTE_HAS_LIBNUMA 1
+#endif
+#endif
+#include <exception>
+#include <string>
 
 namespace declarative {
 
@@ -47,9 +85,11 @@ namespace declarative {
  */
 enum class MemoryPolicy {
     Standard,      // Standard new/delete
-    Pooled,        // Memory pool with reuse
-    Preallocated,  // Preallocate and reuse
-    ZeroCopy       // Minimize copying
+    Pooled,        // Memory pool with reuse (scratch buffers stay cached)
+    Preallocated,  // Preallocate and reuse (scratch buffers stay cached)
+    // process() always returns a fresh results vector, so no policy can
+    // make it zero-copy; write into caller-owned memory instead
+    ZeroCopy [[deprecated("use process_into or process_inplace")]]
 };
 
 /**
@@ -59,7 +99,7 @@ enum class ConcurrencyPolicy {
     Sequential,    // Single-threaded execution
     Parallel,      // Multi-threaded parallel
     Adaptive,      // Automatically choose based on workload
-    ThreadPool     // Reusable thread pool
+    ThreadPool     // Reusable thread pool (shared or ProcessConfig::pool)
 };
 
 /**
@@ -72,6 +112,93 @@ enum class SafetyPolicy {
     ThreadSafe     // Full thread safety guarantees
 };
 
+/**
+ * Task scheduling strategies for ThreadPool
+ */
+enum class SchedulerPolicy {
+    SharedQueue,   // One locked queue shared by all workers
+    WorkStealing   // Per-worker deques + injection queue, random-victim stealing
+};
+
+/**
+ * Submission queue used by ThreadPool::enqueue from non-worker threads
+ */
+enum class SubmissionQueue {
+    Locked,        // Unbounded queue behind a mutex
+    LockFree       // Bounded lock-free MPMC ring (ThreadPoolConfig::queue_capacity)
+};
+
+/**
+ * What enqueue does when a bounded submission queue is full
+ * Called from one of the pool's own workers, Block and Spin run the task
+ * inline instead, so nested submissions cannot wait on a queue that only
+ * the waiting workers would drain.
+ */
+enum class BackpressurePolicy {
+    Block,         // Sleep until a worker frees a slot
+    Spin,          // Retry (yielding) until a slot frees up
+    Reject,        // Return false without queuing
+    RunInline      // Run the task on the submitting thread
+};
+
+/**
+ * Worker placement on CPUs (see CpuTopology)
+ */
+enum class AffinityPolicy {
+    None,          // Let the OS schedule workers freely
+    Explicit,      // Pin worker i to cpus[i % cpus.size()]
+    Compact,       // Fill SMT siblings, then cores, then sockets
+    Spread         // One worker per core across sockets, SMT siblings last
+};
+
+/**
+ * What idle ThreadPool workers do before blocking
+ */
+enum class IdleStrategy {
+    Park,          // Block on a condition variable right away
+    SpinThenPark,  // Spin (pause) for spin_time, yield for yield_time, then block
+    Adaptive       // SpinThenPark, spin time tuned to observed gaps between tasks
+};
+
+/**
+ * Scheduling class of submitted work (ThreadPool lanes)
+ */
+enum class TaskPriority {
+    Interactive,   // Latency-sensitive; dequeued first
+    Normal,        // Default
+    Background     // Bulk work; served when nothing else waits, with aging
+};
+
+/**
+ * How parallel calls split their input into chunks
+ */
+enum class Partitioner {
+    Static,        // One equal slice per thread
+    Dynamic,       // chunk_size items per claim, handed out on demand
+    Guided,        // Claims shrink with the remaining work, down to chunk_size
+    Auto           // Static for small inputs, Guided otherwise
+};
+
+/**
+ * What a call does when func throws
+ */
+enum class ErrorPolicy {
+    Capture,       // Stop early; report through success/error_message/exception
+    Rethrow,       // Stop early; rethrow the original exception from process()
+    CollectAll     // Process every item; record each failure in errors
+};
+
+/**
+ * Whether algorithms that gather computed values (filter_map, pipeline
+ * collect(), hash_join) keep them in input order; filter always does
+ */
+enum class OrderPolicy {
+    Preserve,      // Output in input order
+    Unordered      // Any order; one pass with per-runner buffers
+};
+
+class ThreadPool;
+
 /**
  * Configuration structure for declarative processing
  */
@@ -80,8 +207,32 @@ struct ProcessConfig {
     ConcurrencyPolicy concurrency = ConcurrencyPolicy::Adaptive;
     SafetyPolicy safety = SafetyPolicy::Standard;
     size_t max_threads = std::thread::hardware_concurrency();
-    size_t chunk_size = 1000;
+    size_t chunk_size = 1000;      // Items per claim (Dynamic), smallest claim (Guided/Auto)
     bool enable_logging = false;
+    ThreadPool* pool = nullptr;    // Executor to use (nullptr = ThreadPool::shared())
+    AffinityPolicy affinity = AffinityPolicy::None;  // Pinned shared pool when pool == nullptr
+    std::vector<size_t> cpus;      // CPU ids for Explicit (restricts Compact/Spread)
+    bool numa_aware = false;       // Per-node worker groups, node-local chunks
+    TaskPriority priority = TaskPriority::Normal;  // Class of this call's tasks
+    Partitioner partitioner = Partitioner::Auto;
+    ErrorPolicy on_error = ErrorPolicy::Capture;
+    OrderPolicy order = OrderPolicy::Preserve;
+};
+
+/**
+ * Configuration structure for ThreadPool construction
+ */
+struct ThreadPoolConfig {
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    SchedulerPolicy scheduler = SchedulerPolicy::SharedQueue;
+    SubmissionQueue submission = SubmissionQueue::Locked;
+    size_t queue_capacity = 4096;
+    BackpressurePolicy backpressure = BackpressurePolicy::Block;
+    AffinityPolicy affinity = AffinityPolicy::None;
+    std::vector<size_t> cpus;      // CPU ids for Explicit (restricts Compact/Spread)
+    IdleStrategy idle = IdleStrategy::Park;
+    std::chrono::microseconds spin_time{50};   // Longest spin (Adaptive: upper bound)
+    std::chrono::microseconds yield_time{50};  // Yield phase after spinning
 };
 
 // ============================================================================
@@ -150,355 +301,5184 @@ private:
 };
 
 /**
- * RAII Thread Pool
- * Manages worker threads with automatic cleanup
+ * Move-only type-erased task
+ * Callables up to INLINE_SIZE bytes (and nothrow-movable) are stored in
+ * place, so submitting them never allocates; larger ones go to the heap.
+ * Unlike std::function, move-only captures are accepted.
  */
-class ThreadPool {
+class Task {
+public:
+    static constexpr size_t INLINE_SIZE = 112;
+
 private:
-    std::vector<std::thread> workers_;
-    std::vector<std::function<void()>> tasks_;
-    std::mutex mutex_;
-    std::condition_variable condition_;
-    bool stop_ = false;
-    size_t active_tasks_ = 0;
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template<typename F>
+    struct InlineOps {
+        static void invoke(void* p) { (*static_cast<F*>(p))(); }
+        static void move(void* dst, void* src) noexcept {
+            ::new (dst) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        }
+        static void destroy(void* p) noexcept { static_cast<F*>(p)->~F(); }
+        static constexpr Ops ops{&invoke, &move, &destroy};
+    };
+
+    template<typename F>
+    struct HeapOps {
+        static F*& target(void* p) { return *static_cast<F**>(p); }
+        static void invoke(void* p) { (*target(p))(); }
+        static void move(void* dst, void* src) noexcept {
+            ::new (dst) F*(target(src));
+        }
+        static void destroy(void* p) noexcept { delete target(p); }
+        static constexpr Ops ops{&invoke, &move, &destroy};
+    };
+
+    template<typename F>
+    static constexpr bool fits_inline =
+        sizeof(F) <= INLINE_SIZE &&
+        alignof(F) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible_v<F>;
+
+    const Ops* ops_ = nullptr;
+    alignas(std::max_align_t) unsigned char storage_[INLINE_SIZE];
 
 public:
-    explicit ThreadPool(size_t num_threads) {
-        workers_.reserve(num_threads);
-        
-        for (size_t i = 0; i < num_threads; ++i) {
-            workers_.emplace_back([this] {
-                while (true) {
-                    std::function<void()> task;
-                    
-                    {
-                        std::unique_lock<std::mutex> lock(mutex_);
-                        condition_.wait(lock, [this] {
-                            return stop_ || !tasks_.empty();
-                        });
-                        
-                        if (stop_ && tasks_.empty()) {
-                            return;
-                        }
-                        
-                        task = std::move(tasks_.back());
-                        tasks_.pop_back();
-                        active_tasks_++;
-                    }
-                    
-                    task();
-                    
-                    {
-                        std::lock_guard<std::mutex> lock(mutex_);
-                        active_tasks_--;
-                    }
-                }
-            });
+    Task() noexcept = default;
+
+    template<typename Func,
+             typename F = std::decay_t<Func>,
+             typename = std::enable_if_t<!std::is_same_v<F, Task>>>
+    Task(Func&& func) {
+        if constexpr (fits_inline<F>) {
+            ::new (static_cast<void*>(storage_)) F(std::forward<Func>(func));
+            ops_ = &InlineOps<F>::ops;
+        } else {
+            ::new (static_cast<void*>(storage_)) F*(new F(std::forward<Func>(func)));
+            ops_ = &HeapOps<F>::ops;
         }
     }
 
-    ~ThreadPool() {
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            stop_ = true;
+    Task(Task&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
         }
-        
-        condition_.notify_all();
-        
-        for (auto& worker : workers_) {
-            if (worker.joinable()) {
-                worker.join();
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.ops_) {
+                other.ops_->move(storage_, other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
             }
         }
+        return *this;
     }
 
-    template<typename Func>
-    void enqueue(Func&& task) {
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            tasks_.emplace_back(std::forward<Func>(task));
+    ~Task() { reset(); }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    void operator()() { ops_->invoke(storage_); }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
         }
-        condition_.notify_one();
     }
+};
 
-    void wait_all() {
-        while (true) {
-            std::lock_guard<std::mutex> lock(mutex_);
-            if (tasks_.empty() && active_tasks_ == 0) {
-                break;
+/**
+ * Handle to the result of ThreadPool::submit
+ * get() runs the task on the calling thread if no worker has started it
+ * yet, so waiting from inside a pool task cannot deadlock.
+ */
+template<typename R>
+class TaskFuture {
+public:
+    struct State {
+        using Value = std::conditional_t<std::is_void_v<R>, char, R>;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<bool> claimed{false};
+        bool ready = false;
+        Task task;
+        std::optional<Value> value;
+        std::exception_ptr error;
+
+        void run_once() {
+            if (claimed.exchange(true)) {
+                return;
+            }
+            
+            try {
+                task();
+            } catch (...) {
+                error = std::current_exception();
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            task.reset();
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            ready = true;
+            condition.notify_all();
         }
+
+        // Settles the future with failure; the task never runs
+        void reject(std::exception_ptr failure) {
+            claimed.store(true);
+            task.reset();
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::move(failure);
+            ready = true;
+            condition.notify_all();
+        }
+    };
+
+private:
+    std::shared_ptr<State> state_;
+
+public:
+    TaskFuture() = default;
+    explicit TaskFuture(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+    bool valid() const { return state_ != nullptr; }
+
+    bool ready() const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->ready;
     }
 
-    size_t worker_count() const { return workers_.size(); }
+    void wait() const {
+        state_->run_once();
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->condition.wait(lock, [this] { return state_->ready; });
+    }
+
+    // Rethrows the task's exception; may be called once
+    R get() {
+        wait();
+        std::shared_ptr<State> state = std::move(state_);
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+        if constexpr (!std::is_void_v<R>) {
+            return std::move(*state->value);
+        }
+    }
 };
 
-// ============================================================================
-// SECTION 3: SMART PROCESSORS (Declarative Executors)
-// ============================================================================
+namespace detail {
 
 /**
- * Result wrapper with metrics
+ * Minimal test-and-test-and-set lock for short critical sections
  */
-template<typename T>
-struct ProcessResult {
-    std::vector<T> results;
-    size_t items_processed = 0;
-    double execution_time_ms = 0.0;
-    size_t threads_used = 0;
-    size_t memory_allocated = 0;
-    bool success = true;
-    std::string error_message;
+class SpinLock {
+private:
+    std::atomic<bool> locked_{false};
+
+public:
+    void lock() {
+        while (locked_.exchange(true, std::memory_order_acquire)) {
+            while (locked_.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !locked_.load(std::memory_order_relaxed) &&
+               !locked_.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() { locked_.store(false, std::memory_order_release); }
 };
 
 /**
- * Sequential processor (baseline)
+ * Growable circular buffer usable as a deque (power-of-two capacity)
  */
-template<typename InputT, typename OutputT, typename Func>
-ProcessResult<OutputT> process_sequential(
-    const std::vector<InputT>& input,
-    Func&& func,
-    const ProcessConfig& config
-) {
-    auto start = std::chrono::high_resolution_clock::now();
-    
-    ProcessResult<OutputT> result;
-    result.results.reserve(input.size());
-    result.threads_used = 1;
-    
-    try {
-        for (const auto& item : input) {
-            result.results.push_back(func(item));
+template<typename T>
+class RingDeque {
+private:
+    std::vector<T> slots_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+
+public:
+    explicit RingDeque(size_t capacity = 64) {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        slots_.resize(cap);
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    void push_back(T&& value) {
+        if (size_ == slots_.size()) {
+            grow();
         }
-        
-        result.items_processed = input.size();
-        result.success = true;
-        
-    } catch (const std::exception& e) {
-        result.success = false;
-        result.error_message = e.what();
+        slots_[(head_ + size_) & (slots_.size() - 1)] = std::move(value);
+        ++size_;
     }
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    result.execution_time_ms = 
-        std::chrono::duration<double, std::milli>(end - start).count();
-    
-    return result;
-}
+
+    bool pop_back(T& out) {
+        if (size_ == 0) return false;
+        --size_;
+        out = std::move(slots_[(head_ + size_) & (slots_.size() - 1)]);
+        return true;
+    }
+
+    bool pop_front(T& out) {
+        if (size_ == 0) return false;
+        out = std::move(slots_[head_]);
+        head_ = (head_ + 1) & (slots_.size() - 1);
+        --size_;
+        return true;
+    }
+
+private:
+    void grow() {
+        std::vector<T> bigger(slots_.size() * 2);
+        for (size_t i = 0; i < size_; ++i) {
+            bigger[i] = std::move(slots_[(head_ + i) & (slots_.size() - 1)]);
+        }
+        slots_.swap(bigger);
+        head_ = 0;
+    }
+};
 
 /**
- * Parallel processor with thread pool
+ * Bounded lock-free multi-producer/multi-consumer ring (Vyukov).
+ * Each cell carries a sequence number telling producers and consumers
+ * whose turn it is, so push/pop are a single CAS on the shared position.
  */
-template<typename InputT, typename OutputT, typename Func>
-ProcessResult<OutputT> process_parallel(
-    const std::vector<InputT>& input,
-    Func&& func,
-    const ProcessConfig& config
-) {
-    auto start = std::chrono::high_resolution_clock::now();
-    
-    ProcessResult<OutputT> result;
-    result.results.resize(input.size());
-    result.threads_used = std::min(config.max_threads, input.size());
-    
-    try {
-        ThreadPool pool(result.threads_used);
-        std::vector<std::future<void>> futures;
-        
-        size_t chunk_size = std::max(size_t(1), 
-                                     input.size() / result.threads_used);
+template<typename T>
+class MpmcQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) std::atomic<size_t> dequeue_pos_{0};
+
+public:
+    explicit MpmcQueue(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        cells_.reset(new Cell[cap]);
+        mask_ = cap - 1;
+        for (size_t i = 0; i < cap; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Moves from value only on success
+    bool try_push(T& value) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
         
-        for (size_t i = 0; i < input.size(); i += chunk_size) {
-            size_t end = std::min(i + chunk_size, input.size());
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - pos);
             
-            futures.push_back(std::async(std::launch::async, [&, i, end]() {
-                for (size_t j = i; j < end; ++j) {
-                    result.results[j] = func(input[j]);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
                 }
-            }));
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
         }
         
-        // Wait for all tasks
-        for (auto& future : futures) {
-            future.wait();
-        }
+        cell->data = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& out) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
         
-        result.items_processed = input.size();
-        result.success = true;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+            
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
         
-    } catch (const std::exception& e) {
-        result.success = false;
-        result.error_message = e.what();
+        out = std::move(cell->data);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
     }
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    result.execution_time_ms = 
-        std::chrono::duration<double, std::milli>(end - start).count();
-    
-    return result;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    size_t size_approx() const {
+        size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+};
+
+// Spin-wait hint: lets the sibling hyperthread run and saves power
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#else
+    std::this_thread::yield();
+#endif
 }
 
 /**
- * Adaptive processor - automatically chooses strategy
+ * Spin budget for IdleStrategy::Adaptive, kept per worker: a moving
+ * average of how long the worker sat idle before work arrived. Short gaps
+ * earn a spin of twice the average (capped at the configured spin time);
+ * once gaps outgrow the cap, spinning would only burn CPU and is skipped.
  */
-template<typename InputT, typename OutputT, typename Func>
-ProcessResult<OutputT> process_adaptive(
-    const std::vector<InputT>& input,
-    Func&& func,
-    const ProcessConfig& config
-) {
-    // Decision rules (declarative logic)
-    const size_t PARALLEL_THRESHOLD = 1000;
-    const size_t CORES = std::thread::hardware_concurrency();
-    
-    // Small dataset → Sequential (overhead not worth it)
-    if (input.size() < PARALLEL_THRESHOLD) {
-        return process_sequential<InputT, OutputT>(input, 
-                                                   std::forward<Func>(func), 
-                                                   config);
+class IdleTuner {
+private:
+    double average_gap_us_;
+    double max_spin_us_;
+
+public:
+    explicit IdleTuner(std::chrono::microseconds max_spin)
+        : average_gap_us_(static_cast<double>(max_spin.count())),
+          max_spin_us_(static_cast<double>(max_spin.count())) {}
+
+    void record_gap(std::chrono::steady_clock::duration gap) {
+        double gap_us = std::chrono::duration<double, std::micro>(gap).count();
+        average_gap_us_ = 0.8 * average_gap_us_ + 0.2 * gap_us;
     }
-    
-    // Large dataset + multi-core → Parallel
-    if (input.size() >= PARALLEL_THRESHOLD && CORES > 1) {
-        return process_parallel<InputT, OutputT>(input, 
-                                                std::forward<Func>(func), 
-                                                config);
+
+    std::chrono::microseconds spin_budget() const {
+        if (average_gap_us_ > max_spin_us_) {
+            return std::chrono::microseconds(0);
+        }
+        return std::chrono::microseconds(static_cast<long long>(
+            std::min(max_spin_us_, 2.0 * average_gap_us_ + 1.0)));
     }
-    
-    // Default to sequential
-    return process_sequential<InputT, OutputT>(input, 
-                                              std::forward<Func>(func), 
-                                              config);
-}
+};
 
+/**
+ * Identifies the pool and worker index of the current thread
+ * (pool == nullptr on threads that are not pool workers)
+ */
+struct WorkerContext {
+    ThreadPool* pool = nullptr;
+    size_t index = 0;
+};
+
+inline WorkerContext& current_worker() {
+    static thread_local WorkerContext context;
+    return context;
+}
+
+} // namespace detail
+
+/**
+ * One logical CPU as seen by the OS
+ */
+struct CpuInfo {
+    size_t id = 0;         // Logical CPU number (what affinity masks use)
+    size_t core = 0;       // core_id within its package
+    size_t package = 0;    // Physical socket
+    size_t smt = 0;        // Position among the core's hardware threads
+    size_t node = 0;       // NUMA node
+};
+
+/**
+ * One NUMA node and the CPUs attached to it
+ */
+struct NumaNode {
+    size_t id = 0;
+    std::vector<size_t> cpus;
+};
+
+namespace detail {
+
+// Parses sysfs CPU lists such as "0-3,8,10-11"
+inline std::vector<size_t> parse_cpu_list(const std::string& text) {
+    std::vector<size_t> ids;
+    std::stringstream stream(text);
+    std::string range;
+    
+    while (std::getline(stream, range, ',')) {
+        if (range.empty() || !std::isdigit(static_cast<unsigned char>(range[0]))) {
+            continue;
+        }
+        size_t dash = range.find('-');
+        size_t first = std::stoul(range.substr(0, dash));
+        size_t last = dash == std::string::npos
+            ? first : std::stoul(range.substr(dash + 1));
+        for (size_t id = first; id <= last; ++id) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+// Page size used for NUMA placement decisions
+inline size_t page_size() {
+#if defined(__linux__)
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+// NUMA node holding the page at address, or -1 when unknown
+// (not yet touched, or built without DECLARATIVE_COMPUTE_USE_LIBNUMA)
+inline int page_node(const void* address) {
+#if defined(DECLARATIVE_COMPUTE_HAS_LIBNUMA)
+    void* page = reinterpret_cast<void*>(
+        reinterpret_cast<uintptr_t>(address) & ~(uintptr_t(page_size()) - 1));
+    int status = -1;
+    if (move_pages(0, 1, &page, nullptr, &status, 0) == 0 && status >= 0) {
+        return status;
+    }
+#else
+    (void)address;
+#endif
+    return -1;
+}
+
+inline std::optional<std::string> read_sysfs(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    if (!file || !std::getline(file, line)) {
+        return std::nullopt;
+    }
+    return line;
+}
+
+// Pins the calling thread to one CPU; no-op where unsupported
+inline bool pin_current_thread(size_t cpu) {
+#if defined(__linux__)
+    if (cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+} // namespace detail
+
+/**
+ * CPU Topology
+ * Cores, sockets, SMT siblings and NUMA nodes, read from
+ * /sys/devices/system/cpu and /sys/devices/system/node. Without sysfs
+ * every hardware thread is reported as its own core on package/node 0.
+ */
+class CpuTopology {
+private:
+    std::vector<CpuInfo> cpus_;
+    std::vector<NumaNode> nodes_;
+
+public:
+    explicit CpuTopology(std::vector<CpuInfo> cpus,
+                         std::vector<NumaNode> nodes = {})
+        : cpus_(std::move(cpus)), nodes_(std::move(nodes)) {
+        if (nodes_.empty()) {
+            NumaNode all;
+            for (const auto& cpu : cpus_) {
+                all.cpus.push_back(cpu.id);
+            }
+            nodes_.push_back(std::move(all));
+        }
+    }
+
+    static CpuTopology discover(const std::string& root = "/sys/devices/system/cpu") {
+        std::vector<CpuInfo> cpus;
+        
+        if (auto online = detail::read_sysfs(root + "/online")) {
+            for (size_t id : detail::parse_cpu_list(*online)) {
+                std::string topo = root + "/cpu" + std::to_string(id) + "/topology/";
+                CpuInfo info;
+                info.id = id;
+                info.core = id;
+                
+                if (auto core = detail::read_sysfs(topo + "core_id")) {
+                    info.core = std::stoul(*core);
+                }
+                if (auto package = detail::read_sysfs(topo + "physical_package_id")) {
+                    info.package = std::stoul(*package);
+                }
+                if (auto siblings = detail::read_sysfs(topo + "thread_siblings_list")) {
+                    auto ids = detail::parse_cpu_list(*siblings);
+                    info.smt = static_cast<size_t>(
+                        std::find(ids.begin(), ids.end(), id) - ids.begin());
+                    if (info.smt == ids.size()) {
+                        info.smt = 0;
+                    }
+                }
+                cpus.push_back(info);
+            }
+        }
+        
+        if (cpus.empty()) {
+            size_t count = std::max(1u, std::thread::hardware_concurrency());
+            for (size_t id = 0; id < count; ++id) {
+                CpuInfo info;
+                info.id = id;
+                info.core = id;
+                cpus.push_back(info);
+            }
+            return CpuTopology(std::move(cpus));
+        }
+        
+        std::vector<NumaNode> nodes;
+        std::string node_root = root + "/../node";
+        if (auto online = detail::read_sysfs(node_root + "/online")) {
+            for (size_t id : detail::parse_cpu_list(*online)) {
+                auto list = detail::read_sysfs(
+                    node_root + "/node" + std::to_string(id) + "/cpulist");
+                NumaNode node;
+                node.id = id;
+                for (size_t cpu_id : detail::parse_cpu_list(list.value_or(""))) {
+                    for (auto& cpu : cpus) {
+                        if (cpu.id == cpu_id) {
+                            cpu.node = id;
+                            node.cpus.push_back(cpu_id);
+                        }
+                    }
+                }
+                // Memory-only nodes have no workers to run on
+                if (!node.cpus.empty()) {
+                    nodes.push_back(std::move(node));
+                }
+            }
+        }
+        return CpuTopology(std::move(cpus), std::move(nodes));
+    }
+
+    // Discovered once per process
+    static const CpuTopology& system() {
+        static const CpuTopology topology = discover();
+        return topology;
+    }
+
+    const std::vector<CpuInfo>& cpus() const { return cpus_; }
+    const std::vector<NumaNode>& nodes() const { return nodes_; }
+
+    size_t package_count() const {
+        size_t count = 0;
+        for (const auto& cpu : cpus_) {
+            count = std::max(count, cpu.package + 1);
+        }
+        return count;
+    }
+
+    /**
+     * CPU ids in the order workers should be pinned to them.
+     * Compact: SMT siblings, then the next core, then the next socket.
+     * Spread:  one thread per core round-robin across sockets; SMT
+     *          siblings only once every core has a worker.
+     * Explicit/None: allowed as given (or every CPU in id order).
+     */
+    std::vector<size_t> placement(AffinityPolicy policy,
+                                  const std::vector<size_t>& allowed = {}) const {
+        if (policy == AffinityPolicy::Explicit && !allowed.empty()) {
+            return allowed;
+        }
+        
+        std::vector<CpuInfo> chosen;
+        for (const auto& cpu : cpus_) {
+            if (allowed.empty() ||
+                std::find(allowed.begin(), allowed.end(), cpu.id) != allowed.end()) {
+                chosen.push_back(cpu);
+            }
+        }
+        
+        if (policy == AffinityPolicy::Compact) {
+            std::sort(chosen.begin(), chosen.end(),
+                [](const CpuInfo& a, const CpuInfo& b) {
+                    return std::tie(a.package, a.core, a.smt, a.id) <
+                           std::tie(b.package, b.core, b.smt, b.id);
+                });
+        } else if (policy == AffinityPolicy::Spread) {
+            // Rank of each core inside its package, in core_id order
+            std::vector<std::pair<size_t, size_t>> cores;
+            for (const auto& cpu : chosen) {
+                cores.emplace_back(cpu.package, cpu.core);
+            }
+            std::sort(cores.begin(), cores.end());
+            cores.erase(std::unique(cores.begin(), cores.end()), cores.end());
+            
+            auto core_rank = [&cores](const CpuInfo& cpu) {
+                auto first = std::lower_bound(cores.begin(), cores.end(),
+                                              std::make_pair(cpu.package, size_t(0)));
+                auto self = std::lower_bound(cores.begin(), cores.end(),
+                                             std::make_pair(cpu.package, cpu.core));
+                return static_cast<size_t>(self - first);
+            };
+            
+            std::sort(chosen.begin(), chosen.end(),
+                [&core_rank](const CpuInfo& a, const CpuInfo& b) {
+                    return std::make_tuple(a.smt, core_rank(a), a.package, a.id) <
+                           std::make_tuple(b.smt, core_rank(b), b.package, b.id);
+                });
+        }
+        
+        std::vector<size_t> ids;
+        for (const auto& cpu : chosen) {
+            ids.push_back(cpu.id);
+        }
+        return ids;
+    }
+};
+
+/**
+ * RAII Thread Pool
+ * Manages worker threads with automatic cleanup
+ *
+ * Submitted tasks wait in one FIFO lane per TaskPriority; workers serve
+ * Interactive, then Normal, then Background, except that a lower lane
+ * passed over AGING_LIMIT times in a row gets the next turn.
+ *
+ * SharedQueue: every task goes through the lanes.
+ * WorkStealing: tasks enqueued from a worker go to that worker's own deque
+ * (owner pushes/pops at the back, LIFO) unless they are Interactive;
+ * everything else goes to the lanes. Idle workers check the Interactive
+ * lane, drain their deque, take a batch from the lanes, then steal the
+ * oldest task of a random victim.
+ *
+ * With SubmissionQueue::LockFree each lane is a bounded MPMC ring; when it
+ * is full, enqueue applies the configured BackpressurePolicy.
+ *
+ * With an AffinityPolicy other than None, worker i pins itself to the
+ * i-th CPU of CpuTopology::placement() (wrapping around).
+ *
+ * IdleStrategy trades CPU for wake-up latency: spinning workers are not
+ * parked, so a new burst is picked up without a futex wake-up.
+ */
+class ThreadPool {
+private:
+    struct alignas(64) WorkerQueue {
+        detail::SpinLock lock;
+        detail::RingDeque<Task> tasks;
+        std::atomic<size_t> size{0};
+    };
+
+    // One submission lane per TaskPriority, served in priority order
+    struct Lane {
+        detail::RingDeque<Task> tasks;                  // Guarded by queue_mutex_
+        std::unique_ptr<detail::MpmcQueue<Task>> ring;  // SubmissionQueue::LockFree
+        std::atomic<size_t> depth{0};
+        std::atomic<size_t> skipped{0};
+    };
+
+    static constexpr size_t INJECTION_BATCH = 32;
+    static constexpr size_t LANES = 3;
+    static constexpr size_t AGING_LIMIT = 32;
+
+    std::vector<std::thread> workers_;
+    std::vector<long> worker_cpus_;
+    std::vector<std::unique_ptr<WorkerQueue>> local_queues_;
+    Lane lanes_[LANES];
+    bool lock_free_ = false;
+    std::mutex queue_mutex_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::mutex space_mutex_;
+    std::condition_variable space_condition_;
+    SchedulerPolicy scheduler_;
+    BackpressurePolicy backpressure_;
+    IdleStrategy idle_;
+    std::chrono::microseconds spin_time_;
+    std::chrono::microseconds yield_time_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> parked_{0};
+    std::atomic<size_t> blocked_producers_{0};
+    std::atomic<size_t> active_tasks_{0};
+    std::atomic<size_t> idle_waiters_{0};
+    std::condition_variable idle_condition_;
+    bool stop_ = false;
+
+public:
+    explicit ThreadPool(size_t num_threads)
+        : ThreadPool(with_threads(num_threads)) {}
+
+    explicit ThreadPool(const ThreadPoolConfig& config)
+        : scheduler_(config.scheduler), backpressure_(config.backpressure),
+          idle_(config.idle), spin_time_(config.spin_time),
+          yield_time_(config.yield_time) {
+        if (config.submission == SubmissionQueue::LockFree) {
+            lock_free_ = true;
+            for (auto& lane : lanes_) {
+                lane.ring = std::make_unique<detail::MpmcQueue<Task>>(
+                    config.queue_capacity);
+            }
+        }
+        
+        if (scheduler_ == SchedulerPolicy::WorkStealing) {
+            local_queues_.reserve(config.threads);
+            for (size_t i = 0; i < config.threads; ++i) {
+                local_queues_.push_back(std::make_unique<WorkerQueue>());
+            }
+        }
+        
+        worker_cpus_.assign(config.threads, -1);
+        if (config.affinity != AffinityPolicy::None) {
+            std::vector<size_t> order =
+                CpuTopology::system().placement(config.affinity, config.cpus);
+            for (size_t i = 0; i < config.threads && !order.empty(); ++i) {
+                worker_cpus_[i] = static_cast<long>(order[i % order.size()]);
+            }
+        }
+        
+        workers_.reserve(config.threads);
+        
+        for (size_t i = 0; i < config.threads; ++i) {
+            workers_.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        
+        condition_.notify_all();
+        
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Queues a task. Returns false only when a full lock-free submission
+     * queue rejects it (BackpressurePolicy::Reject); RunInline counts as
+     * accepted.
+     *
+     * Interactive tasks are dequeued before Normal, Normal before
+     * Background; a waiting lower class is served after being passed over
+     * AGING_LIMIT times. With WorkStealing, non-interactive tasks enqueued
+     * by this pool's workers stay in the worker's own deque.
+     */
+    template<typename Func>
+    bool enqueue(Func&& task, TaskPriority priority = TaskPriority::Normal) {
+        const detail::WorkerContext& self = detail::current_worker();
+        const size_t lane = static_cast<size_t>(priority);
+        Task wrapped(std::forward<Func>(task));
+        
+        // Counted before the task is visible: a worker may pop it and
+        // decrement before this call returns (push_bounded counts each
+        // attempt itself)
+        if (scheduler_ == SchedulerPolicy::WorkStealing && self.pool == this &&
+            priority != TaskPriority::Interactive) {
+            queued_.fetch_add(1);
+            WorkerQueue& own = *local_queues_[self.index];
+            std::lock_guard<detail::SpinLock> lock(own.lock);
+            own.tasks.push_back(std::move(wrapped));
+            own.size.store(own.tasks.size(), std::memory_order_relaxed);
+        } else if (lock_free_) {
+            if (!push_bounded(wrapped, lane, self.pool == this)) {
+                if (backpressure_ == BackpressurePolicy::Reject) {
+                    return false;
+                }
+                wrapped();
+                return true;
+            }
+        } else {
+            queued_.fetch_add(1);
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            lanes_[lane].depth.fetch_add(1);
+            lanes_[lane].tasks.push_back(std::move(wrapped));
+        }
+        
+        wake_one();
+        return true;
+    }
+
+    /**
+     * Queues a task and returns a handle to its result. The callable is
+     * stored inline in the shared state (one allocation per call).
+     *
+     * When a full lock-free submission queue refuses the task
+     * (BackpressurePolicy::Reject), it is not run: the handle is ready at
+     * once and get() throws std::runtime_error. Under RunInline the task
+     * runs on the calling thread before submit returns.
+     */
+    template<typename Func,
+             typename R = std::invoke_result_t<std::decay_t<Func>>>
+    TaskFuture<R> submit(Func&& func, TaskPriority priority = TaskPriority::Normal) {
+        auto state = std::make_shared<typename TaskFuture<R>::State>();
+        
+        if constexpr (std::is_void_v<R>) {
+            state->task = Task(std::forward<Func>(func));
+        } else {
+            state->task = Task(
+                [raw = state.get(), f = std::forward<Func>(func)]() mutable {
+                    raw->value.emplace(f());
+                });
+        }
+        
+        auto ticket = [state] { state->run_once(); };
+        if (!enqueue(ticket, priority)) {
+            state->reject(std::make_exception_ptr(
+                std::runtime_error("ThreadPool::submit: submission queue is full")));
+        }
+        return TaskFuture<R>(std::move(state));
+    }
+
+    /**
+     * Blocks until every queued and running task has finished.
+     * Covers the whole pool; use TaskGroup to wait for one job only.
+     * Must not be called from one of this pool's workers.
+     */
+    void wait_all() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_waiters_.fetch_add(1);
+        idle_condition_.wait(lock, [this] {
+            return queued_.load() == 0 && active_tasks_.load() == 0;
+        });
+        idle_waiters_.fetch_sub(1);
+    }
+
+    size_t worker_count() const { return workers_.size(); }
+    SchedulerPolicy scheduler() const { return scheduler_; }
+
+    // Tasks of one class waiting in the submission lanes (tasks kept in
+    // workers' own deques are only counted by queued())
+    size_t queue_depth(TaskPriority priority) const {
+        return lanes_[static_cast<size_t>(priority)].depth.load();
+    }
+
+    size_t queued() const { return queued_.load(); }
+
+    // CPU worker i is pinned to, or -1 when it floats
+    long worker_cpu(size_t index) const { return worker_cpus_[index]; }
+
+    /**
+     * Process-wide executor, created on first use with one worker per
+     * hardware thread and reused by every parallel call afterwards.
+     */
+    static ThreadPool& shared() {
+        static ThreadPool instance(
+            std::max(1u, std::thread::hardware_concurrency()));
+        return instance;
+    }
+
+    // Distinct placements shared(affinity, cpus) keeps pools for
+    static constexpr size_t SHARED_PLACEMENTS = 8;
+
+    /**
+     * Process-wide pinned executor for one placement, created on first use
+     * and reused for every later call with the same policy and CPU list.
+     * Pools live until the process exits, so at most SHARED_PLACEMENTS
+     * placements get one; calls for further placements run on the
+     * unpinned shared() pool. Callers that need many placements should
+     * own ThreadPools and pass them in ProcessConfig::pool.
+     */
+    static ThreadPool& shared(AffinityPolicy affinity,
+                              const std::vector<size_t>& cpus = {}) {
+        ThreadPool* pool = registered(affinity, cpus, true);
+        return pool ? *pool : shared();
+    }
+
+    /**
+     * Process-wide executor pinned to a NUMA node's CPUs, for numa_aware
+     * calls; kept for the process lifetime (one per node, not counted
+     * against SHARED_PLACEMENTS)
+     */
+    static ThreadPool& shared_node(const NumaNode& node) {
+        return *registered(AffinityPolicy::Explicit, node.cpus, false);
+    }
+
+private:
+    // Registry behind shared(affinity, cpus) and shared_node; returns
+    // nullptr when a counted placement would exceed SHARED_PLACEMENTS
+    static ThreadPool* registered(AffinityPolicy affinity, const std::vector<size_t>& cpus,
+                                  bool counted) {
+        static std::mutex registry_mutex;
+        static std::map<std::pair<AffinityPolicy, std::vector<size_t>>,
+                        std::unique_ptr<ThreadPool>> registry;
+        static size_t placements = 0;
+        
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto key = std::make_pair(affinity, cpus);
+        auto found = registry.find(key);
+        if (found != registry.end()) {
+            return found->second.get();
+        }
+        if (counted && placements >= SHARED_PLACEMENTS) {
+            return nullptr;
+        }
+        
+        ThreadPoolConfig config;
+        config.affinity = affinity;
+        config.cpus = cpus;
+        if (affinity == AffinityPolicy::Explicit && !cpus.empty()) {
+            config.threads = cpus.size();
+        }
+        auto& slot = registry[key];
+        slot = std::make_unique<ThreadPool>(config);
+        if (counted) {
+            ++placements;
+        }
+        return slot.get();
+    }
+
+    static ThreadPoolConfig with_threads(size_t num_threads) {
+        ThreadPoolConfig config;
+        config.threads = num_threads;
+        return config;
+    }
+
+    void worker_loop(size_t index) {
+        detail::current_worker() = {this, index};
+        if (worker_cpus_[index] >= 0) {
+            detail::pin_current_thread(static_cast<size_t>(worker_cpus_[index]));
+        }
+        uint64_t rng = 0x9E3779B97F4A7C15ull * (index + 1);
+        detail::IdleTuner tuner(spin_time_);
+        bool idle = false;
+        auto idle_since = std::chrono::steady_clock::now();
+        Task task;
+        
+        while (true) {
+            if (pop_task(index, rng, task)) {
+                if (idle) {
+                    tuner.record_gap(std::chrono::steady_clock::now() - idle_since);
+                    idle = false;
+                }
+                // active before dequeued, so wait_all never sees both at zero
+                active_tasks_.fetch_add(1);
+                queued_.fetch_sub(1);
+                task();
+                task.reset();
+                if (active_tasks_.fetch_sub(1) == 1 && queued_.load() == 0 &&
+                    idle_waiters_.load() > 0) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    idle_condition_.notify_all();
+                }
+                continue;
+            }
+            
+            if (!idle) {
+                idle = true;
+                idle_since = std::chrono::steady_clock::now();
+            }
+            
+            if (idle_ != IdleStrategy::Park) {
+                auto spin = idle_ == IdleStrategy::Adaptive
+                    ? tuner.spin_budget() : spin_time_;
+                if (spin.count() > 0 && spin_for_work(spin)) {
+                    continue;
+                }
+            }
+            
+            std::unique_lock<std::mutex> lock(mutex_);
+            parked_.fetch_add(1);
+            condition_.wait(lock, [this] {
+                return stop_ || queued_.load() > 0;
+            });
+            parked_.fetch_sub(1);
+            
+            if (stop_ && queued_.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    // Pause-spins, then yields, until something is queued or time runs out
+    bool spin_for_work(std::chrono::microseconds spin) {
+        using clock = std::chrono::steady_clock;
+        auto spin_end = clock::now() + spin;
+        
+        for (size_t i = 1;; ++i) {
+            if (queued_.load(std::memory_order_relaxed) > 0) {
+                return true;
+            }
+            detail::cpu_relax();
+            if ((i & 63) == 0 && clock::now() >= spin_end) {
+                break;
+            }
+        }
+        
+        auto yield_end = clock::now() + yield_time_;
+        while (clock::now() < yield_end) {
+            if (queued_.load(std::memory_order_relaxed) > 0) {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        return false;
+    }
+
+    bool pop_task(size_t index, uint64_t& rng, Task& out) {
+        if (scheduler_ == SchedulerPolicy::SharedQueue) {
+            std::unique_lock<std::mutex> lock(queue_mutex_, std::defer_lock);
+            if (!lock_free_) {
+                lock.lock();
+            }
+            size_t lane;
+            return pop_lanes(out, lane);
+        }
+        
+        WorkerQueue& own = *local_queues_[index];
+        
+        // Interactive work goes ahead of this worker's own backlog
+        if (lanes_[0].depth.load(std::memory_order_relaxed) > 0 &&
+            take_injected(own, out)) {
+            return true;
+        }
+        
+        if (own.size.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<detail::SpinLock> lock(own.lock);
+            if (own.tasks.pop_back(out)) {
+                own.size.store(own.tasks.size(), std::memory_order_relaxed);
+                return true;
+            }
+        }
+        
+        return take_injected(own, out) || steal(index, rng, out);
+    }
+
+    // Takes one task to run plus a fair share of the rest of its lane into
+    // the local deque, so other workers steal from here instead
+    bool take_injected(WorkerQueue& own, Task& out) {
+        std::unique_lock<std::mutex> lock(queue_mutex_, std::defer_lock);
+        if (!lock_free_) {
+            lock.lock();
+        }
+        
+        size_t lane;
+        if (!pop_lanes(out, lane)) {
+            return false;
+        }
+        
+        size_t available = lock_free_ ? lanes_[lane].ring->size_approx()
+                                      : lanes_[lane].tasks.size();
+        size_t batch = std::min(available / workers_.size(), INJECTION_BATCH);
+        if (batch > 0) {
+            Task moved[INJECTION_BATCH];
+            size_t count = 0;
+            while (count < batch && pop_lane(lane, moved[count])) {
+                ++count;
+            }
+            note_served(lane, count);
+            
+            // Newest first, so the owner (popping at the back) keeps FIFO order
+            std::lock_guard<detail::SpinLock> own_lock(own.lock);
+            while (count > 0) {
+                own.tasks.push_back(std::move(moved[--count]));
+            }
+            own.size.store(own.tasks.size(), std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Highest-priority lane first, except that a non-empty lane passed over
+    // AGING_LIMIT times is tried first. Locked mode: queue_mutex_ held.
+    bool pop_lanes(Task& out, size_t& served) {
+        size_t order[LANES] = {0, 1, 2};
+        for (size_t l = LANES - 1; l > 0; --l) {
+            if (lanes_[l].skipped.load(std::memory_order_relaxed) >= AGING_LIMIT) {
+                std::rotate(order, order + l, order + l + 1);
+                break;
+            }
+        }
+        
+        for (size_t lane : order) {
+            if (lanes_[lane].depth.load(std::memory_order_relaxed) == 0 ||
+                !pop_lane(lane, out)) {
+                continue;
+            }
+            
+            note_served(lane, 1);
+            served = lane;
+            return true;
+        }
+        return false;
+    }
+
+    // Aging counts tasks, so batches taken into local deques count too
+    void note_served(size_t lane, size_t count) {
+        lanes_[lane].depth.fetch_sub(count);
+        lanes_[lane].skipped.store(0, std::memory_order_relaxed);
+        for (size_t lower = lane + 1; lower < LANES; ++lower) {
+            if (lanes_[lower].depth.load(std::memory_order_relaxed) > 0) {
+                lanes_[lower].skipped.fetch_add(count, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop_lane(size_t lane, Task& out) {
+        return lock_free_ ? pop_bounded(lane, out)
+                          : lanes_[lane].tasks.pop_front(out);
+    }
+
+    bool steal(size_t index, uint64_t& rng, Task& out) {
+        const size_t n = local_queues_.size();
+        if (n < 2) return false;
+        
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        size_t start = static_cast<size_t>(rng % n);
+        
+        for (size_t k = 0; k < n; ++k) {
+            size_t victim = (start + k) % n;
+            if (victim == index) continue;
+            
+            WorkerQueue& other = *local_queues_[victim];
+            if (other.size.load(std::memory_order_relaxed) == 0) continue;
+            
+            std::lock_guard<detail::SpinLock> lock(other.lock);
+            if (other.tasks.pop_front(out)) {
+                other.size.store(other.tasks.size(), std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns false when the ring stayed full under Reject/RunInline
+    // (workers of this pool never block or spin on their own queue). The
+    // task is counted in queued_ and the lane depth only around each push
+    // attempt, so a producer stalled on a full ring does not keep parked
+    // workers from sleeping.
+    bool push_bounded(Task& task, size_t lane, bool from_worker) {
+        detail::MpmcQueue<Task>& ring = *lanes_[lane].ring;
+        auto try_push = [&] {
+            queued_.fetch_add(1);
+            lanes_[lane].depth.fetch_add(1);
+            if (ring.try_push(task)) {
+                return true;
+            }
+            lanes_[lane].depth.fetch_sub(1);
+            queued_.fetch_sub(1);
+            return false;
+        };
+        
+        if (try_push()) {
+            return true;
+        }
+        
+        BackpressurePolicy policy = backpressure_;
+        if (from_worker && (policy == BackpressurePolicy::Block ||
+                            policy == BackpressurePolicy::Spin)) {
+            policy = BackpressurePolicy::RunInline;
+        }
+        
+        switch (policy) {
+            case BackpressurePolicy::Spin:
+                while (!try_push()) {
+                    std::this_thread::yield();
+                }
+                return true;
+            
+            case BackpressurePolicy::Block: {
+                std::unique_lock<std::mutex> lock(space_mutex_);
+                blocked_producers_.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                space_condition_.wait(lock, try_push);
+                blocked_producers_.fetch_sub(1);
+                return true;
+            }
+            
+            case BackpressurePolicy::Reject:
+            case BackpressurePolicy::RunInline:
+            default:
+                return false;
+        }
+    }
+
+    bool pop_bounded(size_t lane, Task& out) {
+        if (!lanes_[lane].ring->try_pop(out)) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (blocked_producers_.load(std::memory_order_relaxed) > 0) {
+            { std::lock_guard<std::mutex> lock(space_mutex_); }
+            space_condition_.notify_one();
+        }
+        return true;
+    }
+
+    // Skips the mutex and futex wake-up when no worker is parked; pairs
+    // with the parked_/queued_ check in worker_loop (both seq_cst)
+    void wake_one() {
+        if (parked_.load() > 0) {
+            { std::lock_guard<std::mutex> lock(mutex_); }
+            condition_.notify_one();
+        }
+    }
+};
+
+namespace detail {
+
+/**
+ * Caps how many threads work on one top-level job at a time. Shared by
+ * the job's nested groups; the thread that started the job holds a slot.
+ * Lives inside the top-level group's state; self lets nested groups keep
+ * that state alive.
+ */
+struct ConcurrencyBudget {
+    std::atomic<size_t> active{1};
+    std::atomic<size_t> limit{1};
+    std::weak_ptr<ConcurrencyBudget> self;
+
+    void reset(size_t max_threads) {
+        active.store(1);
+        limit.store(std::max(size_t(1), max_threads));
+    }
+
+    bool try_acquire() {
+        size_t current = active.load();
+        while (current < limit.load(std::memory_order_relaxed)) {
+            if (active.compare_exchange_weak(current, current + 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void release() { active.fetch_sub(1); }
+};
+
+/**
+ * Pool and budget of the group task running on this thread, if any;
+ * lets nested parallel calls join the enclosing job instead of starting
+ * threads of their own
+ */
+struct ParallelScope {
+    ThreadPool* pool = nullptr;
+    ConcurrencyBudget* budget = nullptr;
+};
+
+inline ParallelScope& current_scope() {
+    static thread_local ParallelScope scope;
+    return scope;
+}
+
+class ScopeGuard {
+private:
+    ParallelScope saved_;
+
+public:
+    ScopeGuard(ThreadPool* pool, ConcurrencyBudget* budget)
+        : saved_(current_scope()) {
+        current_scope() = {pool, budget};
+    }
+
+    ~ScopeGuard() { current_scope() = saved_; }
+
+    ScopeGuard(const ScopeGuard&) = delete;
+    ScopeGuard& operator=(const ScopeGuard&) = delete;
+};
+
+/**
+ * Nested calls run on the enclosing job's pool (or the pool whose worker
+ * is calling), whatever config.pool says, so they never add threads
+ */
+inline ThreadPool& resolve_pool(const ProcessConfig& config) {
+    if (current_scope().pool) {
+        return *current_scope().pool;
+    }
+    if (current_worker().pool) {
+        return *current_worker().pool;
+    }
+    if (config.pool) {
+        return *config.pool;
+    }
+    if (config.affinity != AffinityPolicy::None) {
+        return ThreadPool::shared(config.affinity, config.cpus);
+    }
+    return ThreadPool::shared();
+}
+
+} // namespace detail
+
+/**
+ * Task Group
+ * Tracks one job's tasks on a shared pool so the caller can wait for just
+ * those, without polling. A waiting caller runs the group's not-yet-started
+ * tasks itself (help-while-waiting), so waiting from inside a pool task
+ * cannot starve the pool.
+ *
+ * With max_concurrency > 0, at most that many threads (the creator
+ * included) run the group's tasks at once; idle workers beyond the limit
+ * leave its tasks to the workers inside it, which keep taking them until
+ * none are pending, and to the waiting creator. A group created from inside
+ * another group's task joins that group's limit (nested fork-join).
+ *
+ * The group's tasks are queued in the pool lane of its TaskPriority.
+ *
+ * Example:
+ *   declarative::TaskGroup group(pool);
+ *   group.run([] { step_a(); });
+ *   group.run([] { step_b(); });
+ *   group.wait();  // rethrows the first exception, if any
+ */
+class TaskGroup {
+private:
+    struct State {
+        std::mutex mutex;
+        std::condition_variable condition;
+        detail::RingDeque<Task> pending{16};
+        std::atomic<size_t> outstanding{0};
+        std::exception_ptr error;
+        size_t waiters = 0;
+        ThreadPool* pool = nullptr;
+        std::atomic<size_t> tickets{0};  // Queued or running run_one tickets
+        detail::ConcurrencyBudget* budget = nullptr;
+        detail::ConcurrencyBudget own_budget;
+        std::shared_ptr<detail::ConcurrencyBudget> enclosing;  // Nested groups
+
+        // Runs one pending task; the pool holds one such ticket per task.
+        // Workers outside the job must first get a slot in its budget, and
+        // keep taking pending tasks until they run out before giving the
+        // slot back: tickets that found the budget full are already spent,
+        // so otherwise the tasks over budget would all fall to the creator.
+        bool run_one(bool helping) {
+            bool joined = false;
+            if (!helping && budget && detail::current_scope().budget != budget) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (pending.empty()) {
+                        return false;
+                    }
+                }
+                if (!budget->try_acquire()) {
+                    return false;
+                }
+                joined = true;
+            }
+            
+            bool ran = false;
+            do {
+                Task task;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    pending.pop_front(task);
+                }
+                if (!task) {
+                    break;
+                }
+                
+                {
+                    detail::ScopeGuard scope(pool, budget);
+                    try {
+                        task();
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                }
+                ran = true;
+                
+                if (outstanding.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    condition.notify_all();
+                }
+            } while (joined);
+            
+            if (joined) {
+                budget->release();
+            }
+            return ran;
+        }
+    };
+
+    ThreadPool& pool_;
+    std::shared_ptr<State> state_;
+    TaskPriority priority_;
+
+    // A few finished states per thread are kept for later groups, so
+    // fork-join loops stop allocating. A state is reused once no ticket
+    // (possibly still queued after the caller ran its task) can run.
+    static constexpr size_t SPARE_STATES = 4;
+
+    static std::shared_ptr<State>* spare_states() {
+        static thread_local std::shared_ptr<State> spares[SPARE_STATES];
+        return spares;
+    }
+
+    static std::shared_ptr<State> acquire_state() {
+        std::shared_ptr<State>* spares = spare_states();
+        for (size_t i = 0; i < SPARE_STATES; ++i) {
+            if (spares[i] && spares[i]->tickets.load(std::memory_order_acquire) == 0) {
+                return std::move(spares[i]);
+            }
+        }
+        
+        auto state = std::make_shared<State>();
+        state->own_budget.self =
+            std::shared_ptr<detail::ConcurrencyBudget>(state, &state->own_budget);
+        return state;
+    }
+
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::shared(),
+                       size_t max_concurrency = 0,
+                       TaskPriority priority = TaskPriority::Normal)
+        : pool_(pool), state_(acquire_state()), priority_(priority) {
+        state_->pool = &pool;
+        
+        detail::ConcurrencyBudget* enclosing = detail::current_scope().budget;
+        state_->enclosing.reset();
+        state_->budget = nullptr;
+        if (enclosing) {
+            state_->enclosing = enclosing->self.lock();
+            state_->budget = enclosing;
+        } else if (max_concurrency > 0) {
+            state_->own_budget.reset(max_concurrency);
+            state_->budget = &state_->own_budget;
+        }
+    }
+
+    // Tasks usually reference the creator's stack, so never outlive it
+    ~TaskGroup() {
+        try {
+            wait();
+        } catch (...) {
+        }
+        
+        std::shared_ptr<State>* spares = spare_states();
+        for (size_t i = 0; i < SPARE_STATES; ++i) {
+            if (!spares[i]) {
+                spares[i] = std::move(state_);
+                break;
+            }
+        }
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    template<typename Func>
+    void run(Func&& task) {
+        state_->outstanding.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            state_->pending.push_back(Task(std::forward<Func>(task)));
+            if (state_->waiters > 0) {
+                state_->condition.notify_all();
+            }
+        }
+        
+        state_->tickets.fetch_add(1, std::memory_order_relaxed);
+        auto ticket = [state = state_] {
+            state->run_one(false);
+            state->tickets.fetch_sub(1, std::memory_order_release);
+        };
+        if (!pool_.enqueue(ticket, priority_)) {
+            ticket();
+        }
+    }
+
+    /**
+     * Blocks until every task of this group has finished, running pending
+     * ones on the calling thread meanwhile. Rethrows the first exception
+     * thrown by a task of the group.
+     */
+    void wait() {
+        State& state = *state_;
+        
+        while (state.outstanding.load() > 0) {
+            if (state.run_one(true)) {
+                continue;
+            }
+            
+            std::unique_lock<std::mutex> lock(state.mutex);
+            ++state.waiters;
+            state.condition.wait(lock, [&state] {
+                return state.outstanding.load() == 0 || !state.pending.empty();
+            });
+            --state.waiters;
+        }
+        
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            std::swap(error, state.error);
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    /**
+     * Runs func on the calling thread as part of this group (parallel
+     * calls nested inside it join the group), then waits for the rest
+     */
+    template<typename Func>
+    void run_and_wait(Func&& func) {
+        {
+            detail::ScopeGuard scope(state_->pool, state_->budget);
+            std::forward<Func>(func)();
+        }
+        wait();
+    }
+
+    size_t pending() const { return state_->outstanding.load(); }
+    ThreadPool& pool() const { return pool_; }
+    TaskPriority priority() const { return priority_; }
+};
+
+namespace detail {
+
+/**
+ * Runs run_chunk(0 .. num_chunks-1) on the pool resolved from config, the
+ * calling thread taking the last chunk; returns once all are done
+ */
+template<typename ChunkFn>
+void run_chunks(size_t num_chunks, const ProcessConfig& config, ChunkFn&& run_chunk) {
+    if (num_chunks == 0) {
+        return;
+    }
+    if (num_chunks == 1) {
+        run_chunk(size_t(0));
+        return;
+    }
+    
+    TaskGroup group(resolve_pool(config), config.max_threads, config.priority);
+    
+    for (size_t c = 0; c + 1 < num_chunks; ++c) {
+        group.run([&run_chunk, c]() { run_chunk(c); });
+    }
+    
+    // If this throws, ~TaskGroup still waits for the other chunks
+    group.run_and_wait([&]() { run_chunk(num_chunks - 1); });
+}
+
+/**
+ * NUMA variant: one worker group per node (a shared pool pinned to the
+ * node's CPUs) and each chunk sent to the node holding its input. Returns
+ * false, running nothing, when there is a single node, the caller supplied
+ * its own pool, or the call is nested inside another parallel call.
+ */
+template<typename ChunkFn, typename AddressFn>
+bool run_chunks_numa(size_t num_chunks, const ProcessConfig& config,
+                     ChunkFn&& run_chunk, AddressFn&& chunk_address) {
+    const auto& nodes = CpuTopology::system().nodes();
+    if (nodes.size() < 2 || num_chunks < 2 || config.pool ||
+        current_scope().pool || current_worker().pool) {
+        return false;
+    }
+    
+    std::vector<std::vector<size_t>> chunks_by_node(nodes.size());
+    for (size_t c = 0; c < num_chunks; ++c) {
+        size_t target = c * nodes.size() / num_chunks;
+        int node = page_node(chunk_address(c));
+        for (size_t n = 0; n < nodes.size(); ++n) {
+            if (node >= 0 && nodes[n].id == static_cast<size_t>(node)) {
+                target = n;
+            }
+        }
+        chunks_by_node[target].push_back(c);
+    }
+    
+    std::vector<std::unique_ptr<TaskGroup>> groups;
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        if (chunks_by_node[n].empty()) {
+            continue;
+        }
+        ThreadPool& pool = ThreadPool::shared_node(nodes[n]);
+        groups.push_back(std::make_unique<TaskGroup>(
+            pool, chunks_by_node[n].size() + 1, config.priority));
+        for (size_t c : chunks_by_node[n]) {
+            groups.back()->run([&run_chunk, c]() { run_chunk(c); });
+        }
+    }
+    
+    for (auto& group : groups) {
+        group->wait();
+    }
+    return true;
+}
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * Chunk boundaries are kept at multiples of this many items, so that with
+ * cache-line-aligned output (ResultSlots staging) no two chunks write to the
+ * same line
+ */
+inline size_t cache_line_step(size_t item_size) {
+    size_t a = CACHE_LINE_SIZE;
+    size_t b = item_size;
+    while (b != 0) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return CACHE_LINE_SIZE / a;
+}
+
+inline size_t round_up(size_t value, size_t step) {
+    return (value + step - 1) / step * step;
+}
+
+/**
+ * Cache-line-aligned temporary storage for algorithms that need a second
+ * buffer (sort). With reuse enabled (MemoryPolicy::Pooled/Preallocated)
+ * the buffer goes back to a small per-thread cache when released, and the
+ * next call on that thread takes it if it is large enough.
+ */
+class ScratchBuffer {
+private:
+    static constexpr size_t CACHED = 2;
+    
+    struct Block {
+        void* data = nullptr;
+        size_t bytes = 0;
+    };
+    
+    struct Cache {
+        Block blocks[CACHED];
+        
+        ~Cache() {
+            for (auto& block : blocks) {
+                free_block(block);
+            }
+        }
+    };
+    
+    static Cache& cache() {
+        static thread_local Cache cache;
+        return cache;
+    }
+    
+    static void free_block(Block& block) {
+        if (block.data) {
+            ::operator delete(block.data, std::align_val_t(CACHE_LINE_SIZE));
+            block = Block{};
+        }
+    }
+    
+    Block block_;
+    bool reuse_;
+
+public:
+    ScratchBuffer(size_t bytes, bool reuse) : reuse_(reuse) {
+        if (reuse_) {
+            for (auto& cached : cache().blocks) {
+                if (cached.data && cached.bytes >= bytes) {
+                    std::swap(block_, cached);
+                    return;
+                }
+            }
+        }
+        if (bytes > 0) {
+            block_.data = ::operator new(bytes, std::align_val_t(CACHE_LINE_SIZE));
+            block_.bytes = bytes;
+        }
+    }
+    
+    ~ScratchBuffer() {
+        if (reuse_ && block_.data) {
+            // Keep the largest buffers
+            Block* smallest = &cache().blocks[0];
+            for (auto& cached : cache().blocks) {
+                if (cached.bytes < smallest->bytes) {
+                    smallest = &cached;
+                }
+            }
+            if (smallest->bytes < block_.bytes) {
+                std::swap(*smallest, block_);
+            }
+        }
+        free_block(block_);
+    }
+    
+    ScratchBuffer(const ScratchBuffer&) = delete;
+    ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+    
+    template<typename T>
+    T* as() const noexcept { return static_cast<T*>(block_.data); }
+};
+
+/**
+ * Splits [0, n) into ranges according to config.partitioner and runs
+ * run_range(begin, end) for each on at most `threads` threads (the calling
+ * thread included). Range boundaries other than n are multiples of step.
+ * Returns the number of threads that took part.
+ *
+ * Static runs one precomputed slice per thread. Dynamic and Guided start
+ * one runner per thread that claims ranges from a shared cursor until the
+ * input is exhausted, so threads that draw cheap items take more ranges.
+ * run_range(begin, end, slot) gets the slice or runner index (< threads),
+ * which no two ranges share concurrently, for per-runner state.
+ */
+template<typename RangeFn>
+size_t run_partitioned(size_t n, size_t step, size_t threads,
+                       const ProcessConfig& config, RangeFn&& run_range) {
+    threads = std::max(size_t(1), threads);
+    if (n == 0) {
+        return 1;
+    }
+    const size_t grain = round_up(std::max(size_t(1), config.chunk_size), step);
+    
+    Partitioner partitioner = config.partitioner;
+    if (partitioner == Partitioner::Auto) {
+        partitioner = n <= grain * threads ? Partitioner::Static : Partitioner::Guided;
+    }
+    
+    if (partitioner == Partitioner::Static) {
+        size_t slice = round_up((n + threads - 1) / threads, step);
+        size_t slices = (n + slice - 1) / slice;
+        run_chunks(slices, config, [&](size_t c) {
+            run_range(c * slice, std::min(n, (c + 1) * slice), c);
+        });
+        return slices;
+    }
+    
+    const bool guided = partitioner == Partitioner::Guided;
+    const size_t runners = std::min(threads, (n + grain - 1) / grain);
+    std::atomic<size_t> cursor{0};
+    
+    auto claim = [&](size_t& begin, size_t& end) {
+        if (!guided) {
+            begin = cursor.fetch_add(grain, std::memory_order_relaxed);
+            end = std::min(n, begin + grain);
+            return begin < n;
+        }
+        begin = cursor.load(std::memory_order_relaxed);
+        do {
+            if (begin >= n) {
+                return false;
+            }
+            size_t size = std::max(grain, (n - begin) / (2 * runners));
+            end = std::min(n, round_up(begin + size, step));
+        } while (!cursor.compare_exchange_weak(begin, end, std::memory_order_relaxed));
+        return true;
+    };
+    
+    run_chunks(runners, config, [&](size_t runner) {
+        size_t begin;
+        size_t end;
+        while (claim(begin, end)) {
+            run_range(begin, end, runner);
+        }
+    });
+    return runners;
+}
+
+} // namespace detail
+
+// ============================================================================
+// SECTION 3: SMART PROCESSORS (Declarative Executors)
+// ============================================================================
+
+/**
+ * Non-owning view of contiguous elements (the std::span subset used here,
+ * for C++17). Converts from any container with data() and size().
+ */
+template<typename T>
+class Span {
+private:
+    T* data_ = nullptr;
+    size_t size_ = 0;
+
+public:
+    using element_type = T;
+    using value_type = std::remove_cv_t<T>;
+    using iterator = T*;
+
+    constexpr Span() noexcept = default;
+    constexpr Span(T* data, size_t size) noexcept : data_(data), size_(size) {}
+
+    template<typename Container,
+             typename = std::enable_if_t<std::is_convertible_v<
+                 decltype(std::declval<Container&>().data()), T*>>>
+    constexpr Span(Container& container) noexcept
+        : data_(container.data()), size_(container.size()) {}
+
+    constexpr T* data() const noexcept { return data_; }
+    constexpr size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T& operator[](size_t index) const noexcept { return data_[index]; }
+    constexpr T* begin() const noexcept { return data_; }
+    constexpr T* end() const noexcept { return data_ + size_; }
+
+    constexpr Span subspan(size_t offset, size_t count) const noexcept {
+        return Span(data_ + offset, count);
+    }
+};
+
+template<typename Container>
+Span(Container&) -> Span<std::remove_pointer_t<decltype(std::declval<Container&>().data())>>;
+
+namespace detail {
+
+template<typename It, typename = void>
+struct is_random_access_iterator : std::false_type {};
+
+template<typename It>
+struct is_random_access_iterator<It, std::void_t<
+    typename std::iterator_traits<It>::iterator_category>>
+    : std::is_convertible<typename std::iterator_traits<It>::iterator_category,
+                          std::random_access_iterator_tag> {};
+
+template<typename Range>
+using range_iterator_t = decltype(std::begin(std::declval<const Range&>()));
+
+template<typename Range>
+using range_value_t = typename std::iterator_traits<range_iterator_t<Range>>::value_type;
+
+template<typename Range, typename = void>
+struct is_random_access_range : std::false_type {};
+
+template<typename Range>
+struct is_random_access_range<Range, std::void_t<
+    range_iterator_t<Range>, decltype(std::size(std::declval<const Range&>()))>>
+    : is_random_access_iterator<range_iterator_t<Range>> {};
+
+template<typename T>
+struct is_std_vector : std::false_type {};
+
+template<typename T>
+struct is_std_vector<std::vector<T>> : std::true_type {};
+
+// Inputs taken by the range overloads; std::vector keeps its own
+template<typename Range>
+constexpr bool is_input_range_v =
+    is_random_access_range<Range>::value && !is_std_vector<Range>::value;
+
+// Ranges with contiguous storage (data() returning a pointer), for batch kernels
+template<typename Range, typename = void>
+struct is_contiguous_range : std::false_type {};
+
+template<typename Range>
+struct is_contiguous_range<Range, std::void_t<
+    decltype(std::declval<const Range&>().data()),
+    decltype(std::declval<const Range&>().size())>>
+    : std::is_pointer<decltype(std::declval<const Range&>().data())> {};
+
+/**
+ * Indexable view of a random-access range or iterator pair, so the
+ * processors only need size() and operator[]
+ */
+template<typename It>
+class InputView {
+private:
+    It first_;
+    size_t size_;
+
+public:
+    InputView(It first, size_t size) : first_(first), size_(size) {}
+
+    size_t size() const { return size_; }
+
+    decltype(auto) operator[](size_t index) const {
+        return first_[static_cast<typename std::iterator_traits<It>::difference_type>(index)];
+    }
+};
+
+template<typename Range>
+InputView<range_iterator_t<Range>> view_of(const Range& range) {
+    return {std::begin(range), static_cast<size_t>(std::size(range))};
+}
+
+// Address of an input item for NUMA placement (nullptr for proxy references)
+template<typename Range>
+const void* item_address(const Range& input, size_t index) {
+    if constexpr (std::is_lvalue_reference_v<decltype(input[index])>) {
+        return std::addressof(input[index]);
+    } else {
+        return nullptr;
+    }
+}
+
+/**
+ * Where a parallel call builds its n results. Default-constructible,
+ * move-assignable outputs go straight into results: it is sized up front
+ * and workers assign each slot. Other outputs are constructed in place in
+ * uninitialized, cache-line-aligned staging storage, which keep() moves
+ * into results; bool outputs are staged one byte each (std::vector<bool>
+ * packs bits, so neighbouring writes would race) and packed by keep().
+ * Staged slots with a destructor are tracked as spans (add); unless keep()
+ * succeeds, the destructor destroys exactly those and leaves results
+ * empty. Staging is cached for reuse under MemoryPolicy::Pooled/
+ * Preallocated.
+ */
+template<typename T>
+class ResultSlots {
+public:
+    static constexpr bool packed = std::is_same_v<T, bool>;
+    static constexpr bool direct =
+        !packed && std::is_default_constructible_v<T> && std::is_move_assignable_v<T>;
+    using Slot = std::conditional_t<packed, unsigned char, T>;
+
+private:
+    std::vector<T>& results_;
+    ScratchBuffer staging_;
+    size_t size_;
+    bool kept_ = false;
+    std::mutex mutex_;
+    std::vector<std::pair<size_t, size_t>> spans_;
+
+public:
+    ResultSlots(std::vector<T>& results, size_t n, const ProcessConfig& config)
+        : results_(results),
+          staging_(direct ? 0 : n * sizeof(Slot),
+                   config.memory == MemoryPolicy::Pooled ||
+                   config.memory == MemoryPolicy::Preallocated),
+          size_(n) {
+        if constexpr (direct) {
+            results_.resize(n);
+        }
+    }
+
+    ~ResultSlots() {
+        if (kept_) {
+            return;
+        }
+        if constexpr (!direct && !std::is_trivially_destructible_v<Slot>) {
+            for (const auto& span : spans_) {
+                std::destroy(data() + span.first, data() + span.second);
+            }
+        }
+        std::vector<T>().swap(results_);
+    }
+
+    ResultSlots(const ResultSlots&) = delete;
+    ResultSlots& operator=(const ResultSlots&) = delete;
+
+    Slot* data() noexcept {
+        if constexpr (direct) {
+            return results_.data();
+        } else {
+            return staging_.as<Slot>();
+        }
+    }
+
+    // Builds slot j from value
+    template<typename U>
+    void construct(size_t j, U&& value) {
+        Slot* slot = data() + j;
+        if constexpr (packed) {
+            *slot = static_cast<bool>(value);
+        } else if constexpr (!direct) {
+            ::new (static_cast<void*>(slot)) T(std::forward<U>(value));
+        } else if constexpr (std::is_assignable_v<T&, U&&>) {
+            *slot = std::forward<U>(value);
+        } else {
+            *slot = T(std::forward<U>(value));
+        }
+    }
+
+    // Value-initializes slot j (a failed item under CollectAll)
+    void construct_default(size_t j) {
+        if constexpr (direct) {
+            data()[j] = T();
+        } else {
+            ::new (static_cast<void*>(data() + j)) Slot();
+        }
+    }
+
+    // Moves [first, last) into the slots from index at on
+    template<typename It>
+    void move_in(size_t at, It first, It last) {
+        if constexpr (direct) {
+            std::move(first, last, data() + at);
+        } else {
+            std::uninitialized_move(first, last, data() + at);
+        }
+    }
+
+    // Records staged slots [begin, end) as constructed
+    void add(size_t begin, size_t end) {
+        if constexpr (!direct && !std::is_trivially_destructible_v<Slot>) {
+            if (begin < end) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                spans_.emplace_back(begin, end);
+            }
+        }
+    }
+
+    // Call once every slot is built
+    void keep() {
+        if constexpr (!direct) {
+            if constexpr (packed) {
+                results_.assign(data(), data() + size_);
+            } else {
+                std::vector<T>(std::make_move_iterator(data()),
+                               std::make_move_iterator(data() + size_)).swap(results_);
+                for (const auto& span : spans_) {
+                    std::destroy(data() + span.first, data() + span.second);
+                }
+            }
+        }
+        kept_ = true;
+    }
+};
+
+} // namespace detail
+
+/**
+ * One failed item (ErrorPolicy::CollectAll)
+ */
+struct ItemError {
+    size_t index = 0;
+    std::string message;
+    std::exception_ptr exception;
+};
+
+/**
+ * Metrics and error state of a call
+ *
+ * items_processed counts the items whose output was produced. After an
+ * early stop those need not be a prefix of the input.
+ */
+struct ProcessMetrics {
+    size_t items_processed = 0;
+    double execution_time_ms = 0.0;
+    size_t threads_used = 0;
+    size_t memory_allocated = 0;
+    bool success = true;
+    std::string error_message;
+    std::exception_ptr exception;     // First failure, for rethrowing
+    std::vector<ItemError> errors;    // CollectAll: every failure, by index
+};
+
+/**
+ * Result wrapper with metrics
+ */
+template<typename T>
+struct ProcessResult : ProcessMetrics {
+    std::vector<T> results;
+};
+
+namespace detail {
+
+inline std::string describe(const std::exception_ptr& error) {
+    try {
+        std::rethrow_exception(error);
+    } catch (const std::exception& e) {
+        return e.what();
+    } catch (...) {
+        return "unknown exception";
+    }
+}
+
+/**
+ * Sets success/error_message from the recorded failures; rethrows the
+ * first one under ErrorPolicy::Rethrow
+ */
+inline void settle(ProcessMetrics& result, const ProcessConfig& config) {
+    if (!result.errors.empty()) {
+        std::sort(result.errors.begin(), result.errors.end(),
+                  [](const ItemError& a, const ItemError& b) { return a.index < b.index; });
+        if (!result.exception) {
+            result.exception = result.errors.front().exception;
+        }
+    }
+    
+    result.success = !result.exception;
+    if (result.exception) {
+        result.error_message = describe(result.exception);
+        if (config.on_error == ErrorPolicy::Rethrow) {
+            std::rethrow_exception(result.exception);
+        }
+    }
+}
+
+/**
+ * Threads for a call over n items under config.concurrency; Adaptive
+ * applies the same rule as process_adaptive
+ */
+inline size_t choose_threads(size_t n, const ProcessConfig& config) {
+    if (config.concurrency == ConcurrencyPolicy::Sequential) {
+        return 1;
+    }
+    if (config.concurrency == ConcurrencyPolicy::Adaptive &&
+        (n < 1000 || std::thread::hardware_concurrency() <= 1)) {
+        return 1;
+    }
+    return std::max(size_t(1), std::min(config.max_threads, n));
+}
+
+/**
+ * Runs run_range over [0, n) with NUMA placement when configured, else
+ * with config's partitioner; the first exception goes to metrics. Slots
+ * are as in run_partitioned.
+ */
+template<typename RangeFn, typename AddressFn>
+void dispatch_ranges(size_t n, size_t threads, size_t step, const ProcessConfig& config,
+                     ProcessMetrics& metrics, RangeFn&& run_range, AddressFn&& address) {
+    metrics.threads_used = threads;
+    try {
+        bool placed = false;
+        if (config.numa_aware) {
+            size_t chunk_size = round_up((n + threads - 1) / threads, step);
+            size_t num_chunks = n == 0 ? 0 : (n + chunk_size - 1) / chunk_size;
+            placed = run_chunks_numa(num_chunks, config,
+                [&](size_t c) { run_range(c * chunk_size, std::min(n, (c + 1) * chunk_size), c); },
+                [&](size_t c) { return address(c * chunk_size); });
+        }
+        if (!placed) {
+            metrics.threads_used = run_partitioned(n, step, threads, config, run_range);
+        }
+    } catch (...) {
+        metrics.exception = std::current_exception();
+    }
+}
+
+/**
+ * Runs item(j) for every j in [0, n) on up to `threads` threads, applying
+ * config's partitioner, NUMA placement and error policy. Sets
+ * threads_used, items_processed, errors and exception in metrics; never
+ * throws.
+ *
+ * The first exception raises a flag that every range checks between
+ * items, so the rest of the call stops within one item per thread. Under
+ * ErrorPolicy::CollectAll every item runs, and fill(j) repairs the slot of
+ * a failed item (or rethrows to end the call). done(begin, end) reports
+ * the slots each range wrote, including a range cut short; address(j)
+ * locates item j's input for NUMA placement. item may also take the
+ * range's slot, item(j, slot), to keep per-runner state.
+ */
+template<typename ItemFn, typename FillFn, typename DoneFn, typename AddressFn>
+void run_items(size_t n, size_t threads, size_t step, const ProcessConfig& config,
+               ProcessMetrics& metrics, ItemFn&& item, FillFn&& fill,
+               DoneFn&& done, AddressFn&& address) {
+    std::atomic<bool> failed{false};
+    std::atomic<size_t> processed{0};
+    std::mutex errors_mutex;
+    
+    auto run_item = [&](size_t j, size_t slot) {
+        if constexpr (std::is_invocable_v<ItemFn&, size_t, size_t>) {
+            item(j, slot);
+        } else {
+            item(j);
+        }
+    };
+    
+    auto run_range = [&](size_t begin, size_t end, size_t slot) {
+        size_t j = begin;
+        size_t count = 0;
+        try {
+            for (; j < end && !failed.load(std::memory_order_relaxed); ++j) {
+                if (config.on_error != ErrorPolicy::CollectAll) {
+                    run_item(j, slot);
+                    ++count;
+                    continue;
+                }
+                try {
+                    run_item(j, slot);
+                    ++count;
+                } catch (...) {
+                    auto error = std::current_exception();
+                    {
+                        std::lock_guard<std::mutex> lock(errors_mutex);
+                        metrics.errors.push_back({j, describe(error), error});
+                    }
+                    fill(j);
+                }
+            }
+        } catch (...) {
+            failed.store(true, std::memory_order_relaxed);
+            processed.fetch_add(count, std::memory_order_relaxed);
+            done(begin, j);
+            throw;
+        }
+        processed.fetch_add(count, std::memory_order_relaxed);
+        done(begin, j);
+    };
+    
+    dispatch_ranges(n, threads, step, config, metrics, run_range, address);
+    metrics.items_processed = processed.load();
+}
+
+/**
+ * Batch counterpart of run_items: batch(begin, end) handles a block of
+ * items at once. Each partitioner range is cut into blocks of chunk_size
+ * items (rounded up to step), and cancellation is checked before every
+ * block, so a failure stops the other threads early even under Static's
+ * one range per thread. Under CollectAll a failed block is recorded at its
+ * first index and fill(begin, end) repairs its slots. batch may also take
+ * the range's slot, batch(begin, end, slot), like run_items.
+ */
+template<typename BatchFn, typename FillFn, typename AddressFn>
+void run_batches(size_t n, size_t threads, size_t step, const ProcessConfig& config,
+                 ProcessMetrics& metrics, BatchFn&& batch, FillFn&& fill,
+                 AddressFn&& address) {
+    std::atomic<bool> failed{false};
+    std::atomic<size_t> processed{0};
+    std::mutex errors_mutex;
+    const size_t block = round_up(std::max(size_t(1), config.chunk_size), step);
+    
+    auto run_block = [&](size_t begin, size_t end, size_t slot) {
+        try {
+            if constexpr (std::is_invocable_v<BatchFn&, size_t, size_t, size_t>) {
+                batch(begin, end, slot);
+            } else {
+                batch(begin, end);
+            }
+            processed.fetch_add(end - begin, std::memory_order_relaxed);
+        } catch (...) {
+            if (config.on_error != ErrorPolicy::CollectAll) {
+                failed.store(true, std::memory_order_relaxed);
+                throw;
+            }
+            auto error = std::current_exception();
+            {
+                std::lock_guard<std::mutex> lock(errors_mutex);
+                metrics.errors.push_back({begin, describe(error), error});
+            }
+            try {
+                fill(begin, end);
+            } catch (...) {
+                // A failed repair ends the call like any other failure
+                failed.store(true, std::memory_order_relaxed);
+                throw;
+            }
+        }
+    };
+    
+    auto run_range = [&](size_t begin, size_t end, size_t slot) {
+        while (begin < end && !failed.load(std::memory_order_relaxed)) {
+            const size_t last = end - begin > block ? begin + block : end;
+            run_block(begin, last, slot);
+            begin = last;
+        }
+    };
+    
+    dispatch_ranges(n, threads, step, config, metrics, run_range, address);
+    metrics.items_processed = processed.load();
+}
+
+} // namespace detail
+
+/**
+ * Sequential processor (baseline)
+ */
+template<typename InputT, typename OutputT, typename Func, typename Range>
+ProcessResult<OutputT> process_sequential(
+    const Range& input,
+    Func&& func,
+    const ProcessConfig& config
+) {
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    ProcessResult<OutputT> result;
+    result.results.reserve(input.size());
+    result.threads_used = 1;
+    
+    try {
+        for (size_t i = 0; i < input.size(); ++i) {
+            if (config.on_error != ErrorPolicy::CollectAll) {
+                result.results.push_back(func(input[i]));
+                continue;
+            }
+            try {
+                result.results.push_back(func(input[i]));
+            } catch (...) {
+                if constexpr (!std::is_default_constructible_v<OutputT>) {
+                    throw;
+                } else {
+                    auto error = std::current_exception();
+                    result.errors.push_back({i, detail::describe(error), error});
+                    result.results.emplace_back();
+                }
+            }
+        }
+    } catch (...) {
+        result.exception = std::current_exception();
+    }
+    result.items_processed = result.results.size() - result.errors.size();
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    result.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    detail::settle(result, config);
+    return result;
+}
+
+/**
+ * Parallel processor with thread pool
+ *
+ * Chunks run on config.pool (or the shared process-wide pool); the calling
+ * thread runs the last chunk itself instead of idling. Calls made from
+ * inside a chunk become child tasks of the enclosing call: same pool, and
+ * the outermost call's max_threads bounds all of them together.
+ *
+ * config.partitioner picks how the input is split (see Partitioner);
+ * chunk boundaries fall on output cache lines.
+ *
+ * With config.numa_aware, chunks run on a worker group of the NUMA node
+ * holding their input. NUMA placement needs fixed chunks, so it always
+ * partitions statically.
+ *
+ * Outputs are written as detail::ResultSlots describes: assigned into
+ * the sized results when OutputT is default-constructible and
+ * move-assignable, otherwise constructed in place from func's return value
+ * in staging storage and moved into results, so OutputT needs no default
+ * constructor (except to fill failed slots under CollectAll).
+ *
+ * The first exception stops the other chunks at their next item (see
+ * detail::run_items); a failed call returns empty results.
+ */
+template<typename InputT, typename OutputT, typename Func, typename Range>
+ProcessResult<OutputT> process_parallel(
+    const Range& input,
+    Func&& func,
+    const ProcessConfig& config
+) {
+    using Slots = detail::ResultSlots<OutputT>;
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    ProcessResult<OutputT> result;
+    {
+        Slots slots(result.results, input.size(), config);
+        
+        detail::run_items(input.size(),
+            std::max(size_t(1), std::min(config.max_threads, input.size())),
+            detail::cache_line_step(sizeof(typename Slots::Slot)), config, result,
+            [&](size_t j) { slots.construct(j, func(input[j])); },
+            [&](size_t j) {
+                if constexpr (std::is_default_constructible_v<OutputT>) {
+                    slots.construct_default(j);
+                } else {
+                    std::rethrow_exception(std::current_exception());
+                }
+            },
+            [&](size_t begin, size_t end) { slots.add(begin, end); },
+            [&](size_t j) { return detail::item_address(input, j); });
+        
+        if (!result.exception) {
+            try {
+                slots.keep();
+            } catch (...) {
+                result.exception = std::current_exception();
+            }
+        }
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    result.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    detail::settle(result, config);
+    return result;
+}
+
+/**
+ * Adaptive processor - automatically chooses strategy
+ */
+template<typename InputT, typename OutputT, typename Func, typename Range>
+ProcessResult<OutputT> process_adaptive(
+    const Range& input,
+    Func&& func,
+    const ProcessConfig& config
+) {
+    // Decision rules (declarative logic)
+    const size_t PARALLEL_THRESHOLD = 1000;
+    const size_t CORES = std::thread::hardware_concurrency();
+    
+    // Small dataset → Sequential (overhead not worth it)
+    if (input.size() < PARALLEL_THRESHOLD) {
+        return process_sequential<InputT, OutputT>(input, 
+                                                   std::forward<Func>(func), 
+                                                   config);
+    }
+    
+    // Large dataset + multi-core → Parallel
+    if (input.size() >= PARALLEL_THRESHOLD && CORES > 1) {
+        return process_parallel<InputT, OutputT>(input, 
+                                                std::forward<Func>(func), 
+                                                config);
+    }
+    
+    // Default to sequential
+    return process_sequential<InputT, OutputT>(input, 
+                                              std::forward<Func>(func), 
+                                              config);
+}
+
+// ============================================================================
+// SECTION 4: MAIN API (User-Facing Interface)
+// ============================================================================
+
+namespace detail {
+
+// Dispatch based on concurrency policy
+template<typename InputT, typename OutputT, typename Range, typename Func>
+ProcessResult<OutputT> dispatch(const Range& input, const ProcessConfig& config, Func&& func) {
+    switch (config.concurrency) {
+        case ConcurrencyPolicy::Sequential:
+            return process_sequential<InputT, OutputT>(
+                input, std::forward<Func>(func), config
+            );
+        
+        case ConcurrencyPolicy::Parallel:
+        case ConcurrencyPolicy::ThreadPool:
+            return process_parallel<InputT, OutputT>(
+                input, std::forward<Func>(func), config
+            );
+        
+        case ConcurrencyPolicy::Adaptive:
+        default:
+            return process_adaptive<InputT, OutputT>(
+                input, std::forward<Func>(func), config
+            );
+    }
+}
+
+} // namespace detail
+
+/**
+ * PRIMARY API FUNCTION
+ * 
+ * Declarative processing with automatic optimization
+ * 
+ * Example:
+ *   auto result = declarative::process(data, {
+ *       .memory = MemoryPolicy::Pooled,
+ *       .concurrency = ConcurrencyPolicy::Adaptive,
+ *       .safety = SafetyPolicy::Guaranteed
+ *   }, [](int x) { return x * 2; });
+ */
+template<typename InputT, typename OutputT = InputT, typename Func>
+ProcessResult<OutputT> process(
+    const std::vector<InputT>& input,
+    const ProcessConfig& config,
+    Func&& func
+) {
+    return detail::dispatch<InputT, OutputT>(input, config, std::forward<Func>(func));
+}
+
+/**
+ * Simplified API with default config
+ */
+template<typename InputT, typename Func>
+auto process(const std::vector<InputT>& input, Func&& func) {
+    return process<InputT, 
+                   std::invoke_result_t<Func, InputT>>(
+        input, 
+        ProcessConfig{}, 
+        std::forward<Func>(func)
+    );
+}
+
+/**
+ * Range overloads: std::array, Span / std::span, std::deque, C arrays or
+ * any other random-access range, processed where it lies
+ * instead of being copied into a std::vector. InputT defaults to the
+ * range's value type and OutputT to InputT, as for vectors.
+ *
+ * Example:
+ *   std::array<double, 4096> samples = read_block();
+ *   auto result = declarative::process(samples, config, filter);
+ */
+template<typename InputT = void, typename OutputT = void, typename Range, typename Func,
+         typename = std::enable_if_t<detail::is_input_range_v<Range>>>
+auto process(const Range& input, const ProcessConfig& config, Func&& func) {
+    using In = std::conditional_t<std::is_void_v<InputT>, detail::range_value_t<Range>, InputT>;
+    using Out = std::conditional_t<std::is_void_v<OutputT>, In, OutputT>;
+    return detail::dispatch<In, Out>(detail::view_of(input), config, std::forward<Func>(func));
+}
+
+template<typename Range, typename Func,
+         typename = std::enable_if_t<detail::is_input_range_v<Range>>>
+auto process(const Range& input, Func&& func) {
+    using In = detail::range_value_t<Range>;
+    return detail::dispatch<In, std::invoke_result_t<Func, In>>(
+        detail::view_of(input), ProcessConfig{}, std::forward<Func>(func));
+}
+
+/**
+ * Iterator-pair overloads, for sub-ranges of a larger buffer
+ *
+ * Example:
+ *   auto head = declarative::process(rows.begin(), rows.begin() + n, config, parse);
+ */
+template<typename InputT = void, typename OutputT = void, typename It, typename Func,
+         typename = std::enable_if_t<detail::is_random_access_iterator<It>::value>>
+auto process(It first, It last, const ProcessConfig& config, Func&& func) {
+    using Value = typename std::iterator_traits<It>::value_type;
+    using In = std::conditional_t<std::is_void_v<InputT>, Value, InputT>;
+    using Out = std::conditional_t<std::is_void_v<OutputT>, In, OutputT>;
+    return detail::dispatch<In, Out>(
+        detail::InputView<It>(first, static_cast<size_t>(last - first)),
+        config, std::forward<Func>(func));
+}
+
+template<typename It, typename Func,
+         typename = std::enable_if_t<detail::is_random_access_iterator<It>::value>>
+auto process(It first, It last, Func&& func) {
+    using In = typename std::iterator_traits<It>::value_type;
+    return detail::dispatch<In, std::invoke_result_t<Func, In>>(
+        detail::InputView<It>(first, static_cast<size_t>(last - first)),
+        ProcessConfig{}, std::forward<Func>(func));
+}
+
+/**
+ * Zero-copy API: writes func(input[i]) to output[i] in caller-owned
+ * storage, with process()'s concurrency dispatch. output must hold at
+ * least input.size() elements and must not partially overlap input.
+ * Nothing is allocated per call in steady state.
+ *
+ * Example:
+ *   declarative::process_into(declarative::Span(samples),
+ *                             declarative::Span(scaled), config,
+ *                             [](float x) { return x * 0.5f; });
+ */
+template<typename InputT, typename OutputT, typename Func>
+ProcessMetrics process_into(
+    Span<InputT> input,
+    Span<OutputT> output,
+    const ProcessConfig& config,
+    Func&& func
+) {
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    ProcessMetrics metrics;
+    if (output.size() < input.size()) {
+        metrics.exception = std::make_exception_ptr(
+            std::invalid_argument("process_into: output is smaller than input"));
+    } else {
+        detail::run_items(input.size(), detail::choose_threads(input.size(), config),
+            detail::cache_line_step(sizeof(OutputT)), config, metrics,
+            [&](size_t j) { output[j] = func(std::as_const(input[j])); },
+            [](size_t) {},
+            [](size_t, size_t) {},
+            [&](size_t j) { return &input[j]; });
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    metrics.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    detail::settle(metrics, config);
+    return metrics;
+}
+
+/**
+ * Zero-copy API: transforms data in place. func either returns the new
+ * value (T -> T) or takes T& and modifies it (returning void).
+ *
+ * Example:
+ *   declarative::process_inplace(declarative::Span(frame), config,
+ *                                [](Pixel& p) { p.r = 255 - p.r; });
+ */
+template<typename T, typename Func>
+ProcessMetrics process_inplace(
+    Span<T> data,
+    const ProcessConfig& config,
+    Func&& func
+) {
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    ProcessMetrics metrics;
+    detail::run_items(data.size(), detail::choose_threads(data.size(), config),
+        detail::cache_line_step(sizeof(T)), config, metrics,
+        [&](size_t j) {
+            if constexpr (std::is_invocable_r_v<void, Func&, T&> &&
+                          std::is_void_v<std::invoke_result_t<Func&, T&>>) {
+                func(data[j]);
+            } else {
+                data[j] = func(std::as_const(data[j]));
+            }
+        },
+        [](size_t) {},
+        [](size_t, size_t) {},
+        [&](size_t j) { return &data[j]; });
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    metrics.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    detail::settle(metrics, config);
+    return metrics;
+}
+
+/**
+ * Batch API: calls kernel(in, out) once per block instead of func(item)
+ * once per element, so the kernel can keep state in registers and let
+ * the compiler vectorize its loop. in is a Span<const InputT> over the
+ * block's inputs, out the matching Span<OutputT> of value-initialized
+ * results. Unlike process(), OutputT must be default-constructible: the
+ * kernel assigns into out, so every result must exist before it runs.
+ * Each chunk of config's partitioner is cut into blocks of chunk_size
+ * items, cache-line aligned on the output side, and cancellation is
+ * checked between blocks.
+ *
+ * Failures are per block: under CollectAll a failed block is reported at
+ * its first index and its results are value-initialized again.
+ *
+ * Example:
+ *   auto result = declarative::process_batch<uint8_t>(image, config,
+ *       [](declarative::Span<const Pixel> in, declarative::Span<uint8_t> out) {
+ *           for (size_t i = 0; i < in.size(); ++i) {
+ *               out[i] = (77 * in[i].r + 150 * in[i].g + 29 * in[i].b) >> 8;
+ *           }
+ *       });
+ */
+template<typename OutputT, typename Range, typename Kernel,
+         typename = std::enable_if_t<detail::is_contiguous_range<Range>::value>>
+ProcessResult<OutputT> process_batch(
+    const Range& input,
+    const ProcessConfig& config,
+    Kernel&& kernel
+) {
+    static_assert(!std::is_same_v<OutputT, bool>,
+                  "process_batch: std::vector<bool> has no contiguous storage");
+    static_assert(std::is_default_constructible_v<OutputT>,
+                  "process_batch: OutputT must be default-constructible");
+    using InputT = std::remove_cv_t<std::remove_pointer_t<decltype(input.data())>>;
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    Span<const InputT> in(input.data(), input.size());
+    ProcessResult<OutputT> result;
+    try {
+        result.results.resize(in.size());
+    } catch (...) {
+        result.exception = std::current_exception();
+    }
+    
+    if (!result.exception) {
+        OutputT* out = result.results.data();
+        detail::run_batches(in.size(), detail::choose_threads(in.size(), config),
+            detail::cache_line_step(sizeof(OutputT)), config, result,
+            [&](size_t begin, size_t end) {
+                kernel(in.subspan(begin, end - begin), Span<OutputT>(out + begin, end - begin));
+            },
+            [&](size_t begin, size_t end) {
+                if constexpr (std::is_move_assignable_v<OutputT>) {
+                    for (size_t j = begin; j < end; ++j) {
+                        out[j] = OutputT();
+                    }
+                }
+            },
+            [&](size_t j) { return &in[j]; });
+        
+        if (result.exception) {
+            std::vector<OutputT>().swap(result.results);
+        }
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    result.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    detail::settle(result, config);
+    return result;
+}
+
+/**
+ * Batch API into caller-owned storage (see process_into): output must
+ * hold at least input.size() elements. Under CollectAll a failed chunk's
+ * outputs are left as the kernel left them.
+ */
+template<typename InputT, typename OutputT, typename Kernel>
+ProcessMetrics process_batch(
+    Span<InputT> input,
+    Span<OutputT> output,
+    const ProcessConfig& config,
+    Kernel&& kernel
+) {
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    ProcessMetrics metrics;
+    if (output.size() < input.size()) {
+        metrics.exception = std::make_exception_ptr(
+            std::invalid_argument("process_batch: output is smaller than input"));
+    } else {
+        detail::run_batches(input.size(), detail::choose_threads(input.size(), config),
+            detail::cache_line_step(sizeof(OutputT)), config, metrics,
+            [&](size_t begin, size_t end) {
+                kernel(Span<const InputT>(input.data() + begin, end - begin),
+                       output.subspan(begin, end - begin));
+            },
+            [](size_t, size_t) {},
+            [&](size_t j) { return &input[j]; });
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    metrics.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    detail::settle(metrics, config);
+    return metrics;
+}
+
+// ============================================================================
+// SECTION 5: UTILITIES
+// ============================================================================
+
+/**
+ * Benchmark helper - compare strategies
+ */
+template<typename InputT, typename Func>
+struct BenchmarkResult {
+    double sequential_ms;
+    double parallel_ms;
+    double adaptive_ms;
+    double speedup_parallel;
+    double speedup_adaptive;
+    size_t optimal_threads;
+};
+
+namespace detail {
+
+template<typename InputT, typename Func, typename Range>
+BenchmarkResult<InputT, Func> run_benchmark(
+    const Range& input,
+    Func& func,
+    size_t iterations
+) {
+    BenchmarkResult<InputT, Func> result{};
+    
+    // Sequential baseline
+    {
+        double total = 0.0;
+        for (size_t i = 0; i < iterations; ++i) {
+            auto r = process_sequential<InputT, 
+                                       std::invoke_result_t<Func, InputT>>(
+                input, func, ProcessConfig{}
+            );
+            total += r.execution_time_ms;
+        }
+        result.sequential_ms = total / iterations;
+    }
+    
+    // Parallel
+    {
+        double total = 0.0;
+        ProcessConfig config;
+        config.concurrency = ConcurrencyPolicy::Parallel;
+        
+        for (size_t i = 0; i < iterations; ++i) {
+            auto r = process_parallel<InputT, 
+                                     std::invoke_result_t<Func, InputT>>(
+                input, func, config
+            );
+            total += r.execution_time_ms;
+            result.optimal_threads = r.threads_used;
+        }
+        result.parallel_ms = total / iterations;
+    }
+    
+    // Adaptive
+    {
+        double total = 0.0;
+        for (size_t i = 0; i < iterations; ++i) {
+            auto r = process_adaptive<InputT, 
+                                     std::invoke_result_t<Func, InputT>>(
+                input, func, ProcessConfig{}
+            );
+            total += r.execution_time_ms;
+        }
+        result.adaptive_ms = total / iterations;
+    }
+    
+    result.speedup_parallel = result.sequential_ms / result.parallel_ms;
+    result.speedup_adaptive = result.sequential_ms / result.adaptive_ms;
+    
+    return result;
+}
+
+} // namespace detail
+
+template<typename InputT, typename Func>
+BenchmarkResult<InputT, Func> benchmark(
+    const std::vector<InputT>& input,
+    Func&& func,
+    size_t iterations = 3
+) {
+    return detail::run_benchmark<InputT, Func>(input, func, iterations);
+}
+
+/**
+ * Benchmark over any random-access range (see the process() range overloads)
+ */
+template<typename Range, typename Func,
+         typename = std::enable_if_t<detail::is_input_range_v<Range>>>
+BenchmarkResult<detail::range_value_t<Range>, Func> benchmark(
+    const Range& input,
+    Func&& func,
+    size_t iterations = 3
+) {
+    return detail::run_benchmark<detail::range_value_t<Range>, Func>(
+        detail::view_of(input), func, iterations);
+}
+
+// ============================================================================
+// SECTION 6: PARALLEL ALGORITHMS
 // ============================================================================
-// SECTION 4: MAIN API (User-Facing Interface)
-// ============================================================================
 
 /**
- * PRIMARY API FUNCTION
- * 
- * Declarative processing with automatic optimization
- * 
+ * Result of a reduction: the combined value plus the usual metrics
+ */
+template<typename T>
+struct ReduceResult : ProcessMetrics {
+    T value{};
+};
+
+namespace detail {
+
+/**
+ * Per-runner accumulator on its own cache line, so runners updating
+ * neighbouring slots do not false-share
+ */
+template<typename T>
+struct alignas(CACHE_LINE_SIZE) PaddedSlot {
+    std::optional<T> value;
+};
+
+/**
+ * Combines the engaged slots pairwise (0+1, 2+3, then 0+2, ...), keeping
+ * slot order, and returns the total (empty if no slot was used)
+ */
+template<typename T, typename Combine>
+std::optional<T> tree_combine(std::vector<PaddedSlot<T>>& slots, Combine& combine) {
+    for (size_t stride = 1; stride < slots.size(); stride *= 2) {
+        for (size_t i = 0; i + stride < slots.size(); i += 2 * stride) {
+            auto& left = slots[i].value;
+            auto& right = slots[i + stride].value;
+            if (left && right) {
+                left = combine(std::move(*left), std::move(*right));
+            } else if (right) {
+                left = std::move(right);
+            }
+        }
+    }
+    return slots.empty() ? std::nullopt : std::move(slots[0].value);
+}
+
+/**
+ * A runner's fold state in run_reduce: value holds the items from first up
+ * to (not including) next, and close() files it under first once the
+ * runner moves on to a range that does not continue it
+ */
+template<typename T>
+struct alignas(CACHE_LINE_SIZE) RangeFold {
+    std::optional<T> value;
+    size_t first = 0;
+    size_t next = 0;
+    std::vector<std::pair<size_t, T>> closed;
+    
+    void close() {
+        if (value) {
+            closed.emplace_back(first, std::move(*value));
+            value.reset();
+        }
+    }
+};
+
+/**
+ * Adds value to an accumulator (the first value seeds it)
+ */
+template<typename T, typename V, typename Combine>
+void accumulate(std::optional<T>& acc, V&& value, Combine& combine, const ProcessConfig& config) {
+    if (!acc) {
+        acc.emplace(std::forward<V>(value));
+        return;
+    }
+    if constexpr (std::is_copy_constructible_v<T>) {
+        // CollectAll keeps going, so a throwing combine must not leave
+        // the accumulator moved-from
+        if (config.on_error == ErrorPolicy::CollectAll) {
+            *acc = combine(T(*acc), std::forward<V>(value));
+            return;
+        }
+    }
+    *acc = combine(std::move(*acc), std::forward<V>(value));
+}
+
+/**
+ * Shared reduction driver: fold(acc, j) adds item j to the partial value
+ * of the range it belongs to. Each runner keeps one partial per run of
+ * consecutive items it claimed; the partials are then tree-combined in
+ * input order, so combine need not be commutative under any partitioner.
+ * `empty` is the value when no item was folded. Under CollectAll a failed
+ * item is left out of the value.
+ */
+template<typename T, typename Range, typename Fold, typename Combine>
+ReduceResult<T> run_reduce(const Range& input, const ProcessConfig& config,
+                           Fold&& fold, Combine& combine, T empty) {
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    ReduceResult<T> result;
+    const size_t n = input.size();
+    const size_t threads = choose_threads(n, config);
+    std::vector<RangeFold<T>> runners(threads);
+    
+    run_items(n, threads, 1, config, result,
+        [&](size_t j, size_t slot) {
+            auto& runner = runners[slot];
+            if (j != runner.next) {
+                runner.close();
+                runner.first = j;
+            }
+            runner.next = j + 1;
+            fold(runner.value, j);
+        },
+        [](size_t) {},
+        [](size_t, size_t) {},
+        [&](size_t j) { return item_address(input, j); });
+    
+    if (!result.exception) {
+        try {
+            std::vector<std::pair<size_t, T>> partials;
+            for (auto& runner : runners) {
+                runner.close();
+                std::move(runner.closed.begin(), runner.closed.end(),
+                          std::back_inserter(partials));
+            }
+            std::sort(partials.begin(), partials.end(),
+                      [](const auto& a, const auto& b) { return a.first < b.first; });
+            
+            std::vector<PaddedSlot<T>> slots(partials.size());
+            for (size_t i = 0; i < partials.size(); ++i) {
+                slots[i].value.emplace(std::move(partials[i].second));
+            }
+            auto total = tree_combine(slots, combine);
+            result.value = total ? std::move(*total) : std::move(empty);
+        } catch (...) {
+            result.exception = std::current_exception();
+        }
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    result.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    settle(result, config);
+    return result;
+}
+
+} // namespace detail
+
+/**
+ * Parallel reduction: combines every element with identity using combine,
+ * without materializing an output vector. combine(T, T) -> T must be
+ * associative, and identity neutral for it. Each claimed range is folded
+ * on its own, then the partial values are combined as a tree in input
+ * order, so combine need not be commutative (string concatenation works)
+ * under every partitioner.
+ *
+ * Example:
+ *   auto sum = declarative::reduce(values, config, 0.0,
+ *                                  [](double a, double b) { return a + b; });
+ *   std::cout << sum.value << " in " << sum.execution_time_ms << " ms\n";
+ */
+template<typename Range, typename T, typename Combine,
+         typename = std::enable_if_t<detail::is_random_access_range<Range>::value>>
+ReduceResult<T> reduce(
+    const Range& input,
+    const ProcessConfig& config,
+    T identity,
+    Combine&& combine
+) {
+    auto view = detail::view_of(input);
+    return detail::run_reduce<T>(view, config,
+        [&](std::optional<T>& acc, size_t j) {
+            if (!acc) {
+                acc.emplace(identity);
+            }
+            detail::accumulate(acc, view[j], combine, config);
+        },
+        combine, identity);
+}
+
+/**
+ * Parallel map-reduce: combines map(element) over the input, e.g. a sum of
+ * squares or a statistic, with the same rules for combine as reduce(). An
+ * empty input gives a value-initialized result.
+ *
+ * Example:
+ *   auto norm2 = declarative::map_reduce(values, config,
+ *       [](double x) { return x * x; },
+ *       [](double a, double b) { return a + b; });
+ */
+template<typename Range, typename Map, typename Combine,
+         typename = std::enable_if_t<detail::is_random_access_range<Range>::value>>
+auto map_reduce(
+    const Range& input,
+    const ProcessConfig& config,
+    Map&& map,
+    Combine&& combine
+) {
+    auto view = detail::view_of(input);
+    using T = std::decay_t<std::invoke_result_t<Map&, decltype(view[0])>>;
+    return detail::run_reduce<T>(view, config,
+        [&](std::optional<T>& acc, size_t j) {
+            detail::accumulate(acc, map(view[j]), combine, config);
+        },
+        combine, T{});
+}
+
+namespace detail {
+
+template<typename T>
+struct is_optional : std::false_type {};
+
+template<typename T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+/**
+ * Stream compaction behind filter_map, pipeline collect() and hash_join,
+ * whose values only exist once the user function has run: expand(j,
+ * emit) calls emit(U) for each value item j contributes (any number).
+ * Pass 1 appends emitted values to per-bucket buffers: a fixed block of
+ * the items under OrderPolicy::Preserve (ranges are aligned to whole
+ * blocks, so one runner fills each block in order), the runner's slot
+ * under Unordered. The bucket sizes are exclusive-scanned into output
+ * offsets, and pass 2 moves every buffer to its offset in parallel. No
+ * step takes a lock. An item that throws contributes no values. Results
+ * are written into result, whose metrics may already hold earlier phases.
+ */
+template<typename U, typename Result, typename Expand, typename AddressFn>
+void run_expand(size_t n, const ProcessConfig& config, Result& result,
+                Expand&& expand, AddressFn&& address) {
+    static_assert(!std::is_same_v<U, bool>,
+                  "std::vector<bool> results have no contiguous storage");
+    
+    const size_t threads = choose_threads(n, config);
+    const bool ordered = config.order == OrderPolicy::Preserve;
+    
+    // A few blocks per thread, so Dynamic and Guided can still balance
+    const size_t block = ordered
+        ? std::max(size_t(1), (n + threads * 8 - 1) / (threads * 8)) : 1;
+    const size_t buckets = ordered ? (n + block - 1) / block : threads;
+    std::vector<std::vector<U>> buffers(buckets);
+    
+    run_items(n, threads, block, config, result,
+        [&](size_t j, size_t slot) {
+            auto& buffer = buffers[ordered ? j / block : slot];
+            const size_t before = buffer.size();
+            try {
+                expand(j, [&buffer](U&& value) { buffer.push_back(std::move(value)); });
+            } catch (...) {
+                // A failed item contributes nothing
+                buffer.erase(buffer.begin() + before, buffer.end());
+                throw;
+            }
+        },
+        [](size_t) {},
+        [](size_t, size_t) {},
+        address);
+    
+    if (!result.exception) {
+        std::vector<size_t> offsets(buckets + 1, 0);
+        for (size_t b = 0; b < buckets; ++b) {
+            offsets[b + 1] = offsets[b] + buffers[b].size();
+        }
+        
+        try {
+            ResultSlots<U> slots(result.results, offsets[buckets], config);
+            auto scatter = [&](size_t b) {
+                slots.move_in(offsets[b], buffers[b].begin(), buffers[b].end());
+                slots.add(offsets[b], offsets[b + 1]);
+                std::vector<U>().swap(buffers[b]);
+            };
+            
+            if (threads == 1) {
+                for (size_t b = 0; b < buckets; ++b) {
+                    scatter(b);
+                }
+            } else {
+                run_chunks(buckets, config, scatter);
+            }
+            slots.keep();
+        } catch (...) {
+            result.exception = std::current_exception();
+        }
+    }
+}
+
+/**
+ * filter's count / scan / scatter: pass 1 evaluates pred once per item
+ * and keeps a flag byte per item (an item whose pred throws is not kept);
+ * the kept items of each block are counted and exclusive-scanned into
+ * output offsets, and pass 2 copies every block's kept items straight to
+ * its offset in results. Nothing is buffered and no step takes a lock.
+ * Blocks land in input order, so OrderPolicy makes no difference here.
+ */
+template<typename T, typename Range, typename Pred>
+ProcessResult<T> run_filter(const Range& input, const ProcessConfig& config, Pred& pred) {
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    ProcessResult<T> result;
+    const size_t n = input.size();
+    const size_t threads = choose_threads(n, config);
+    
+    // A few blocks per thread, so Dynamic and Guided can still balance
+    const size_t block = std::max(size_t(1), (n + threads * 8 - 1) / (threads * 8));
+    const size_t blocks = (n + block - 1) / block;
+    const bool reuse = config.memory == MemoryPolicy::Pooled ||
+                       config.memory == MemoryPolicy::Preallocated;
+    ScratchBuffer scratch(n, reuse);
+    unsigned char* kept = scratch.as<unsigned char>();
+    
+    run_items(n, threads, block, config, result,
+        [&](size_t j) { kept[j] = pred(input[j]) ? 1 : 0; },
+        [&](size_t j) { kept[j] = 0; },
+        [](size_t, size_t) {},
+        [&](size_t j) { return item_address(input, j); });
+    
+    if (!result.exception) {
+        auto each_block = [&](auto&& body) {
+            if (threads == 1) {
+                for (size_t b = 0; b < blocks; ++b) {
+                    body(b);
+                }
+            } else {
+                run_chunks(blocks, config, body);
+            }
+        };
+        
+        try {
+            std::vector<size_t> offsets(blocks + 1, 0);
+            each_block([&](size_t b) {
+                size_t count = 0;
+                for (size_t j = b * block, last = std::min(n, j + block); j < last; ++j) {
+                    count += kept[j];
+                }
+                offsets[b + 1] = count;
+            });
+            for (size_t b = 0; b < blocks; ++b) {
+                offsets[b + 1] += offsets[b];
+            }
+            
+            ResultSlots<T> slots(result.results, offsets[blocks], config);
+            each_block([&](size_t b) {
+                size_t at = offsets[b];
+                try {
+                    for (size_t j = b * block, last = std::min(n, j + block); j < last; ++j) {
+                        if (kept[j]) {
+                            slots.construct(at, input[j]);
+                            ++at;
+                        }
+                    }
+                } catch (...) {
+                    slots.add(offsets[b], at);
+                    throw;
+                }
+                slots.add(offsets[b], at);
+            });
+            slots.keep();
+        } catch (...) {
+            result.exception = std::current_exception();
+        }
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    result.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    settle(result, config);
+    return result;
+}
+
+/**
+ * run_expand for at most one value per item: select(j) returns a
+ * std::optional<U>
+ */
+template<typename U, typename Range, typename Select>
+ProcessResult<U> run_compact(const Range& input, const ProcessConfig& config, Select&& select) {
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    ProcessResult<U> result;
+    run_expand<U>(input.size(), config, result,
+        [&](size_t j, auto&& emit) {
+            if (auto kept = select(j)) {
+                emit(std::move(*kept));
+            }
+        },
+        [&](size_t j) { return item_address(input, j); });
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    result.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    settle(result, config);
+    return result;
+}
+
+} // namespace detail
+
+/**
+ * Parallel filter: results holds copies of the elements for which pred
+ * returns true (items_processed counts every element examined), in input
+ * order whatever config.order says. Counts kept items per block, scans
+ * the counts into offsets and scatters straight into results (see
+ * detail::run_filter). Under CollectAll an element whose pred throws is
+ * dropped.
+ *
+ * Example:
+ *   auto errors = declarative::filter(log_lines, config,
+ *       [](const Line& l) { return l.level == Level::Error; });
+ */
+template<typename Range, typename Pred,
+         typename = std::enable_if_t<detail::is_random_access_range<Range>::value>>
+ProcessResult<detail::range_value_t<Range>> filter(
+    const Range& input,
+    const ProcessConfig& config,
+    Pred&& pred
+) {
+    using T = detail::range_value_t<Range>;
+    auto view = detail::view_of(input);
+    return detail::run_filter<T>(view, config, pred);
+}
+
+/**
+ * Parallel filter + transform in one pass: func returns std::optional<U>,
+ * and results holds the engaged values. Replaces mapping to optionals with
+ * process() and compacting afterwards. The values do not exist before
+ * func runs, so unlike filter they are buffered per block (or per runner
+ * under OrderPolicy::Unordered) and then moved into place (see
+ * detail::run_expand).
+ *
+ * Example:
+ *   auto ids = declarative::filter_map(records, config,
+ *       [](const Record& r) -> std::optional<int> {
+ *           if (!r.active) return std::nullopt;
+ *           return r.id;
+ *       });
+ */
+template<typename Range, typename Func,
+         typename = std::enable_if_t<detail::is_random_access_range<Range>::value>>
+auto filter_map(
+    const Range& input,
+    const ProcessConfig& config,
+    Func&& func
+) {
+    auto view = detail::view_of(input);
+    using Selected = std::decay_t<std::invoke_result_t<Func&, decltype(view[0])>>;
+    static_assert(detail::is_optional<Selected>::value,
+                  "filter_map: func must return std::optional<U>");
+    return detail::run_compact<typename Selected::value_type>(view, config,
+        [&](size_t j) -> Selected { return func(view[j]); });
+}
+
+namespace detail {
+
+// Standard commutative operators whose arithmetic reductions may be split
+// across independent lanes
+template<typename Op, typename T>
+struct is_lane_op : std::false_type {};
+
+template<typename T> struct is_lane_op<std::plus<T>, T> : std::is_arithmetic<T> {};
+template<typename T> struct is_lane_op<std::plus<>, T> : std::is_arithmetic<T> {};
+template<typename T> struct is_lane_op<std::multiplies<T>, T> : std::is_arithmetic<T> {};
+template<typename T> struct is_lane_op<std::multiplies<>, T> : std::is_arithmetic<T> {};
+template<typename T> struct is_lane_op<std::bit_and<T>, T> : std::is_integral<T> {};
+template<typename T> struct is_lane_op<std::bit_and<>, T> : std::is_integral<T> {};
+template<typename T> struct is_lane_op<std::bit_or<T>, T> : std::is_integral<T> {};
+template<typename T> struct is_lane_op<std::bit_or<>, T> : std::is_integral<T> {};
+template<typename T> struct is_lane_op<std::bit_xor<T>, T> : std::is_integral<T> {};
+template<typename T> struct is_lane_op<std::bit_xor<>, T> : std::is_integral<T> {};
+
+/**
+ * Combines input[begin, end) (non-empty) with op. For is_lane_op the fold
+ * runs on SCAN_LANES independent accumulators, which the compiler turns
+ * into vector instructions without reassociating floating point itself.
+ */
+constexpr size_t SCAN_LANES = 8;
+
+template<typename T, typename Range, typename Op>
+T fold_block(const Range& input, size_t begin, size_t end, Op& op) {
+    if constexpr (is_lane_op<std::decay_t<Op>, T>::value) {
+        if (end - begin >= 2 * SCAN_LANES) {
+            T lanes[SCAN_LANES];
+            for (size_t k = 0; k < SCAN_LANES; ++k) {
+                lanes[k] = input[begin + k];
+            }
+            size_t i = begin + SCAN_LANES;
+            for (; i + SCAN_LANES <= end; i += SCAN_LANES) {
+                for (size_t k = 0; k < SCAN_LANES; ++k) {
+                    lanes[k] = op(lanes[k], input[i + k]);
+                }
+            }
+            T acc = lanes[0];
+            for (size_t k = 1; k < SCAN_LANES; ++k) {
+                acc = op(acc, lanes[k]);
+            }
+            for (; i < end; ++i) {
+                acc = op(acc, input[i]);
+            }
+            return acc;
+        }
+    }
+    T acc = input[begin];
+    for (size_t i = begin + 1; i < end; ++i) {
+        acc = op(std::move(acc), input[i]);
+    }
+    return acc;
+}
+
+/**
+ * Two-pass (reduce-then-scan) prefix scan. The input is cut into blocks
+ * of at least chunk_size items, about one per thread: pass 1 folds every
+ * block but the last, the block totals are scanned serially into each
+ * block's carry-in, and pass 2 rescans every block from its carry-in,
+ * constructing the outputs. One block (a sequential call) skips pass 1.
+ * init is the exclusive scan's initial value; inclusive scans pass none.
+ */
+template<typename T, bool Inclusive, typename Range, typename Op>
+ProcessResult<T> run_scan(const Range& input, const ProcessConfig& config,
+                          std::optional<T> init, Op& op) {
+    static_assert(!std::is_same_v<T, bool>,
+                  "scan: std::vector<bool> has no contiguous storage");
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    ProcessResult<T> result;
+    const size_t n = input.size();
+    const size_t threads = choose_threads(n, config);
+    const size_t step = cache_line_step(sizeof(T));
+    const size_t block = std::max(size_t(1), round_up(
+        std::max(config.chunk_size, (n + threads - 1) / threads), step));
+    const size_t blocks = (n + block - 1) / block;
+    
+    // A failed item poisons every later output, so failures always end the
+    // call; CollectAll only reports the first one
+    ProcessConfig scan_config = config;
+    if (scan_config.on_error == ErrorPolicy::CollectAll) {
+        scan_config.on_error = ErrorPolicy::Capture;
+    }
+    
+    auto each_block = [&](size_t begin, size_t end, auto&& body) {
+        for (size_t b = begin / block; b * block < end; ++b) {
+            body(b, b * block, std::min(n, (b + 1) * block));
+        }
+    };
+    
+    // Pass 1: block totals, turned into carry-ins (slot b = all before b)
+    std::vector<PaddedSlot<T>> carry(blocks);
+    if (blocks > 1) {
+        ProcessMetrics totals;
+        run_batches(n - block, threads, block, scan_config, totals,
+            [&](size_t begin, size_t end) {
+                each_block(begin, end, [&](size_t b, size_t first, size_t last) {
+                    carry[b].value.emplace(fold_block<T>(input, first, last, op));
+                });
+            },
+            [](size_t, size_t) {},
+            [&](size_t j) { return item_address(input, j); });
+        result.exception = totals.exception;
+    }
+    
+    if (!result.exception) {
+        try {
+            std::optional<T> running = std::move(init);
+            for (size_t b = 0; b < blocks; ++b) {
+                std::optional<T> total = std::move(carry[b].value);
+                carry[b].value = running;
+                if (total) {
+                    running = running ? std::optional<T>(op(std::move(*running), std::move(*total)))
+                                      : std::move(total);
+                }
+            }
+        } catch (...) {
+            result.exception = std::current_exception();
+        }
+    }
+    
+    if (!result.exception) {
+        // Pass 2: rescan each block from its carry-in, writing in place
+        ResultSlots<T> slots(result.results, n, config);
+        
+        run_batches(n, threads, block, scan_config, result,
+            [&](size_t begin, size_t end) {
+                each_block(begin, end, [&](size_t b, size_t first, size_t last) {
+                    size_t built = first;
+                    try {
+                        std::optional<T>& carry_in = carry[b].value;
+                        size_t i = first;
+                        if (!carry_in) {
+                            // Inclusive scan's first block
+                            carry_in.emplace(input[i]);
+                            slots.construct(i, *carry_in);
+                            built = ++i;
+                        }
+                        T acc = std::move(*carry_in);
+                        for (; i < last; ++i) {
+                            if constexpr (Inclusive) {
+                                acc = op(std::move(acc), input[i]);
+                                slots.construct(i, acc);
+                                built = i + 1;
+                            } else {
+                                slots.construct(i, acc);
+                                built = i + 1;
+                                acc = op(std::move(acc), input[i]);
+                            }
+                        }
+                    } catch (...) {
+                        slots.add(first, built);
+                        throw;
+                    }
+                    slots.add(first, last);
+                });
+            },
+            [](size_t, size_t) {},
+            [&](size_t j) { return item_address(input, j); });
+        
+        if (!result.exception) {
+            try {
+                slots.keep();
+            } catch (...) {
+                result.exception = std::current_exception();
+            }
+        }
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    result.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    settle(result, config);
+    return result;
+}
+
+} // namespace detail
+
+/**
+ * Parallel inclusive scan: results[i] = input[0] op ... op input[i]. op
+ * must be associative (it need not be commutative). Block size honors
+ * config.chunk_size and max_threads; std::plus, std::multiplies and the
+ * bitwise operators on arithmetic types fold each block in vector lanes.
+ *
+ * Example:
+ *   auto cumulative = declarative::inclusive_scan(daily, config, std::plus<>());
+ */
+template<typename Range, typename Op,
+         typename = std::enable_if_t<detail::is_random_access_range<Range>::value>>
+ProcessResult<detail::range_value_t<Range>> inclusive_scan(
+    const Range& input,
+    const ProcessConfig& config,
+    Op&& op
+) {
+    using T = detail::range_value_t<Range>;
+    return detail::run_scan<T, true>(detail::view_of(input), config, std::nullopt, op);
+}
+
+/**
+ * Parallel exclusive scan: results[0] = init and results[i] = init op
+ * input[0] op ... op input[i - 1], e.g. offsets from sizes
+ *
+ * Example:
+ *   auto offsets = declarative::exclusive_scan(sizes, config, size_t(0), std::plus<>());
+ */
+template<typename Range, typename T, typename Op,
+         typename = std::enable_if_t<detail::is_random_access_range<Range>::value>>
+ProcessResult<T> exclusive_scan(
+    const Range& input,
+    const ProcessConfig& config,
+    T init,
+    Op&& op
+) {
+    return detail::run_scan<T, false>(detail::view_of(input), config,
+                                      std::optional<T>(std::move(init)), op);
+}
+
+namespace detail {
+
+// Keys the radix path handles: integers (not bool) and IEEE float/double
+template<typename K>
+constexpr bool is_radix_key_v =
+    ((std::is_integral_v<K> && !std::is_same_v<K, bool>) ||
+     std::is_same_v<K, float> || std::is_same_v<K, double>) && sizeof(K) <= 8;
+
+template<typename K>
+using radix_uint_t = std::conditional_t<sizeof(K) == 1, uint8_t,
+                     std::conditional_t<sizeof(K) == 2, uint16_t,
+                     std::conditional_t<sizeof(K) == 4, uint32_t, uint64_t>>>;
+
+/**
+ * Maps a key to unsigned bits with the same order: the sign bit is
+ * flipped for signed integers, and negative floats have all bits flipped
+ */
+template<typename K>
+radix_uint_t<K> radix_bits(K key) {
+    using U = radix_uint_t<K>;
+    constexpr U sign = U(U(1) << (sizeof(K) * 8 - 1));
+    U bits;
+    std::memcpy(&bits, &key, sizeof(K));
+    if constexpr (std::is_floating_point_v<K>) {
+        return (bits & sign) ? U(~bits) : U(bits | sign);
+    } else if constexpr (std::is_signed_v<K>) {
+        return U(bits ^ sign);
+    } else {
+        return bits;
+    }
+}
+
+// std::less / std::greater on T itself (or transparent), which radix order matches
+template<typename Compare, typename T>
+constexpr bool is_less_op_v =
+    std::is_same_v<Compare, std::less<>> || std::is_same_v<Compare, std::less<T>>;
+
+template<typename Compare, typename T>
+constexpr bool is_greater_op_v =
+    std::is_same_v<Compare, std::greater<>> || std::is_same_v<Compare, std::greater<T>>;
+
+/**
+ * Parallel LSD radix sort, one byte per pass. Each pass counts digits per
+ * block, turns the counts into per-block output offsets and scatters every
+ * block in order (so passes are stable); passes where every item has the
+ * same digit are skipped. Data ping-pongs between the input and scratch;
+ * if bits_of throws, the input is restored to a permutation first.
+ */
+template<typename It, typename T, typename Bits>
+void radix_sort(It first, size_t n, T* scratch, size_t threads,
+                const ProcessConfig& config, Bits& bits_of) {
+    using U = std::decay_t<decltype(bits_of(std::declval<const T&>()))>;
+    constexpr size_t RADIX = 256;
+    
+    const size_t blocks = threads;
+    const size_t block = (n + blocks - 1) / blocks;
+    std::vector<std::array<size_t, RADIX>> counts(blocks);
+    bool in_scratch = false;
+    
+    auto copy_back = [&]() {
+        run_chunks(blocks, config, [&](size_t p) {
+            size_t begin = p * block;
+            size_t end = std::min(n, begin + block);
+            std::copy(scratch + begin, scratch + end, first + begin);
+        });
+    };
+    
+    auto pass = [&](auto src, auto dst, size_t shift) {
+        run_chunks(blocks, config, [&](size_t p) {
+            auto& count = counts[p];
+            count.fill(0);
+            for (size_t i = p * block, end = std::min(n, i + block); i < end; ++i) {
+                ++count[(bits_of(src[i]) >> shift) & (RADIX - 1)];
+            }
+        });
+        
+        size_t offset = 0;
+        for (size_t d = 0; d < RADIX; ++d) {
+            size_t total = 0;
+            for (size_t p = 0; p < blocks; ++p) {
+                size_t c = counts[p][d];
+                counts[p][d] = offset + total;
+                total += c;
+            }
+            if (total == n) {
+                return false;
+            }
+            offset += total;
+        }
+        
+        run_chunks(blocks, config, [&](size_t p) {
+            auto& next = counts[p];
+            for (size_t i = p * block, end = std::min(n, i + block); i < end; ++i) {
+                dst[next[(bits_of(src[i]) >> shift) & (RADIX - 1)]++] = src[i];
+            }
+        });
+        return true;
+    };
+    
+    try {
+        for (size_t shift = 0; shift < sizeof(U) * 8; shift += 8) {
+            bool moved = in_scratch ? pass(scratch, first, shift) : pass(first, scratch, shift);
+            if (moved) {
+                in_scratch = !in_scratch;
+            }
+        }
+    } catch (...) {
+        // Scatters only read their source, which still holds every item
+        if (in_scratch) {
+            copy_back();
+        }
+        throw;
+    }
+    if (in_scratch) {
+        copy_back();
+    }
+}
+
+/**
+ * Parallel merge sort: one block per thread is sorted in place, then
+ * sorted runs are merged pairwise, ping-ponging between the input and
+ * scratch. Every merge is split by merge path (binary search for the
+ * co-rank of each output position) into parts of about n / threads
+ * items, so all threads stay busy through the last round. The splits are
+ * all found before any part moves items out of the source. Merges are
+ * stable; the result is stable when blocks use std::stable_sort.
+ */
+template<typename It, typename T, typename Compare>
+void merge_sort(It first, size_t n, T* scratch, size_t threads,
+                const ProcessConfig& config, Compare& comp, bool stable) {
+    const size_t block = (n + threads - 1) / threads;
+    const size_t blocks = (n + block - 1) / block;
+    
+    // Non-trivial items are moved into scratch so both buffers hold
+    // constructed objects for the merge rounds to assign between
+    constexpr bool construct = !std::is_trivially_copyable_v<T>;
+    std::vector<char> built(construct ? blocks : 0, 0);
+    
+    auto destroy_built = [&]() {
+        if constexpr (construct) {
+            for (size_t p = 0; p < blocks; ++p) {
+                if (built[p]) {
+                    std::destroy(scratch + p * block, scratch + std::min(n, (p + 1) * block));
+                }
+            }
+        }
+    };
+    
+    try {
+        run_chunks(blocks, config, [&](size_t p) {
+            size_t begin = p * block;
+            size_t end = std::min(n, begin + block);
+            if (stable) {
+                std::stable_sort(first + begin, first + end, comp);
+            } else {
+                std::sort(first + begin, first + end, comp);
+            }
+            if constexpr (construct) {
+                std::uninitialized_move(first + begin, first + end, scratch + begin);
+                built[p] = 1;
+            }
+        });
+        
+        std::vector<size_t> bounds;
+        for (size_t p = 0; p <= blocks; ++p) {
+            bounds.push_back(std::min(n, p * block));
+        }
+        
+        // Output [from, to) of merging [begin, middle) with [middle, end),
+        // taking A items [a_from, a_to)
+        struct Part { size_t begin, middle, end, from, to, a_from, a_to; };
+        std::vector<Part> parts;
+        bool in_scratch = construct;
+        
+        while (bounds.size() > 2) {
+            parts.clear();
+            std::vector<size_t> merged;
+            for (size_t r = 0; r + 1 < bounds.size(); r += 2) {
+                size_t begin = bounds[r];
+                size_t middle = bounds[r + 1];
+                size_t end = r + 2 < bounds.size() ? bounds[r + 2] : middle;
+                for (size_t k = 0; k < end - begin; k += block) {
+                    parts.push_back({begin, middle, end, k, std::min(end - begin, k + block), 0, 0});
+                }
+                merged.push_back(begin);
+            }
+            merged.push_back(n);
+            
+            auto merge_parts = [&](auto src, auto dst) {
+                // Items of A among the first k outputs (A wins ties)
+                auto co_rank = [&](const Part& part, size_t k) {
+                    auto a = src + part.begin;
+                    auto b = src + part.middle;
+                    size_t lo = k > part.end - part.middle ? k - (part.end - part.middle) : 0;
+                    size_t hi = std::min(k, part.middle - part.begin);
+                    while (lo < hi) {
+                        size_t mid = lo + (hi - lo) / 2;
+                        if (!comp(b[k - mid - 1], a[mid])) {
+                            lo = mid + 1;
+                        } else {
+                            hi = mid;
+                        }
+                    }
+                    return lo;
+                };
+                for (size_t i = 0; i < parts.size(); ++i) {
+                    Part& part = parts[i];
+                    part.a_from = i > 0 && parts[i - 1].begin == part.begin
+                        ? parts[i - 1].a_to : co_rank(part, part.from);
+                    part.a_to = co_rank(part, part.to);
+                }
+                
+                run_chunks(parts.size(), config, [&](size_t i) {
+                    const Part& part = parts[i];
+                    auto a = src + part.begin;
+                    auto b = src + part.middle;
+                    std::merge(std::make_move_iterator(a + part.a_from),
+                               std::make_move_iterator(a + part.a_to),
+                               std::make_move_iterator(b + (part.from - part.a_from)),
+                               std::make_move_iterator(b + (part.to - part.a_to)),
+                               dst + part.begin + part.from, comp);
+                });
+            };
+            
+            if (in_scratch) {
+                merge_parts(scratch, first);
+            } else {
+                merge_parts(first, scratch);
+            }
+            in_scratch = !in_scratch;
+            bounds = std::move(merged);
+        }
+        
+        if (in_scratch) {
+            run_chunks(blocks, config, [&](size_t p) {
+                size_t begin = p * block;
+                size_t end = std::min(n, begin + block);
+                std::move(scratch + begin, scratch + end, first + begin);
+            });
+        }
+    } catch (...) {
+        destroy_built();
+        throw;
+    }
+    destroy_built();
+}
+
+/**
+ * Shared driver for sort and sort_by_key. Sequential calls, and inputs
+ * under two chunk_size blocks, use std::sort/std::stable_sort; otherwise
+ * one block per thread, each at least chunk_size items. With a bits_of
+ * (not nullptr) the radix path runs from RADIX_MIN_ITEMS items, even on
+ * one thread.
+ */
+constexpr size_t RADIX_MIN_ITEMS = 2048;
+
+template<typename It, typename Compare, typename Bits>
+ProcessMetrics run_sort(It first, size_t n, const ProcessConfig& config,
+                        Compare& comp, Bits& bits_of, bool stable) {
+    using T = typename std::iterator_traits<It>::value_type;
+    static_assert(alignof(T) <= CACHE_LINE_SIZE, "sort: over-aligned items are not supported");
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    ProcessMetrics metrics;
+    size_t threads = choose_threads(n, config);
+    threads = std::max(size_t(1), std::min(threads, n / std::max(size_t(1), config.chunk_size)));
+    metrics.threads_used = threads;
+    
+    try {
+        const bool reuse = config.memory == MemoryPolicy::Pooled ||
+                           config.memory == MemoryPolicy::Preallocated;
+        bool radix = false;
+        if constexpr (!std::is_same_v<Bits, std::nullptr_t>) {
+            radix = n >= RADIX_MIN_ITEMS;
+            if (radix) {
+                ScratchBuffer scratch(n * sizeof(T), reuse);
+                radix_sort(first, n, scratch.as<T>(), threads, config, bits_of);
+            }
+        }
+        if (radix) {
+            // Done above
+        } else if (threads == 1) {
+            if (stable) {
+                std::stable_sort(first, first + n, comp);
+            } else {
+                std::sort(first, first + n, comp);
+            }
+        } else {
+            ScratchBuffer scratch(n * sizeof(T), reuse);
+            merge_sort(first, n, scratch.as<T>(), threads, config, comp, stable);
+        }
+        metrics.items_processed = n;
+    } catch (...) {
+        metrics.exception = std::current_exception();
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    metrics.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    settle(metrics, config);
+    return metrics;
+}
+
+} // namespace detail
+
+/**
+ * Parallel in-place sort of a random-access range (a std::vector, a
+ * process() result's results, a Span, ...). Generic comparators use a
+ * parallel merge sort; arithmetic items with std::less or std::greater
+ * (the default is std::less<>) use an LSD radix sort. Not stable. Scratch
+ * storage is cached for reuse under MemoryPolicy::Pooled/Preallocated. If
+ * comp throws, the call fails with the basic guarantee: items may have
+ * been moved out to scratch and not back, so every item of data is valid
+ * but its value is unspecified.
+ *
+ * Example:
+ *   auto result = declarative::process(data, config, score);
+ *   declarative::sort(result.results, config, std::greater<>());
+ */
+template<typename Range, typename Compare = std::less<>,
+         typename = std::enable_if_t<detail::is_random_access_range<std::decay_t<Range>>::value>>
+ProcessMetrics sort(
+    Range&& data,
+    const ProcessConfig& config,
+    Compare comp = Compare{}
+) {
+    auto first = std::begin(data);
+    const size_t n = static_cast<size_t>(std::size(data));
+    using T = typename std::iterator_traits<decltype(first)>::value_type;
+    
+    if constexpr (detail::is_radix_key_v<T> &&
+                  (detail::is_less_op_v<Compare, T> || detail::is_greater_op_v<Compare, T>)) {
+        auto bits_of = [](const T& item) {
+            if constexpr (detail::is_greater_op_v<Compare, T>) {
+                return detail::radix_uint_t<T>(~detail::radix_bits(item));
+            } else {
+                return detail::radix_bits(item);
+            }
+        };
+        return detail::run_sort(first, n, config, comp, bits_of, false);
+    } else {
+        std::nullptr_t no_bits = nullptr;
+        return detail::run_sort(first, n, config, comp, no_bits, false);
+    }
+}
+
+/**
+ * Parallel stable sort by key(item), ascending. Integer and float keys on
+ * trivially copyable items use the LSD radix sort (key should be cheap:
+ * it runs twice per byte of key); other keys use the merge sort with
+ * key(a) < key(b). If key or the comparison throws, items are left valid
+ * but with unspecified values, as for sort.
+ *
+ * Example:
+ *   declarative::sort_by_key(orders, config,
+ *                            [](const Order& o) { return o.timestamp; });
+ */
+template<typename Range, typename KeyFn,
+         typename = std::enable_if_t<detail::is_random_access_range<std::decay_t<Range>>::value>>
+ProcessMetrics sort_by_key(
+    Range&& data,
+    const ProcessConfig& config,
+    KeyFn&& key
+) {
+    auto first = std::begin(data);
+    const size_t n = static_cast<size_t>(std::size(data));
+    using T = typename std::iterator_traits<decltype(first)>::value_type;
+    using K = std::decay_t<std::invoke_result_t<KeyFn&, const T&>>;
+    
+    auto comp = [&key](const T& a, const T& b) { return key(a) < key(b); };
+    if constexpr (detail::is_radix_key_v<K> && std::is_trivially_copyable_v<T>) {
+        auto bits_of = [&key](const T& item) { return detail::radix_bits<K>(key(item)); };
+        return detail::run_sort(first, n, config, comp, bits_of, true);
+    } else {
+        std::nullptr_t no_bits = nullptr;
+        return detail::run_sort(first, n, config, comp, no_bits, true);
+    }
+}
+
+/**
+ * Lazy, fused chain of stages over an input range, built by pipeline().
+ * map and filter only compose: nothing runs until a terminal (collect or
+ * reduce), which makes a single pass in which every item goes through all
+ * stages back to back, under the pipeline's ProcessConfig. No intermediate
+ * vectors are allocated.
+ *
+ * Stages are pushed rather than pulled: chain(item, sink) calls sink with
+ * the item's value after the stages so far, or not at all if a filter
+ * dropped it. A Pipeline refers to its input, which must outlive the
+ * terminal call.
+ */
+template<typename Source, typename T, typename Chain, bool Filtered>
+class Pipeline {
+private:
+    Source source_;
+    ProcessConfig config_;
+    Chain chain_;
+
+public:
+    using value_type = T;
+
+    Pipeline(Source source, ProcessConfig config, Chain chain)
+        : source_(std::move(source)), config_(std::move(config)), chain_(std::move(chain)) {}
+
+    /**
+     * Transforms every value with func. Workers share one copy of every
+     * stage, so func must be callable as const (no mutable lambdas).
+     */
+    template<typename Func>
+    auto map(Func func) const {
+        static_assert(std::is_invocable_v<const Func&, T>,
+                      "Pipeline::map: func must be const-invocable (stages run concurrently)");
+        using U = std::decay_t<std::invoke_result_t<const Func&, T>>;
+        auto chain = [prev = chain_, func = std::move(func)](auto&& item, auto&& sink) {
+            prev(std::forward<decltype(item)>(item), [&](auto&& value) {
+                sink(func(std::forward<decltype(value)>(value)));
+            });
+        };
+        return Pipeline<Source, U, decltype(chain), Filtered>(source_, config_, std::move(chain));
+    }
+
+    /**
+     * Keeps the values for which pred returns true; pred must be callable
+     * as const, like map's func
+     */
+    template<typename Pred>
+    auto filter(Pred pred) const {
+        static_assert(std::is_invocable_v<const Pred&, const T&>,
+                      "Pipeline::filter: pred must be const-invocable (stages run concurrently)");
+        auto chain = [prev = chain_, pred = std::move(pred)](auto&& item, auto&& sink) {
+            prev(std::forward<decltype(item)>(item), [&](auto&& value) {
+                if (pred(std::as_const(value))) {
+                    sink(std::forward<decltype(value)>(value));
+                }
+            });
+        };
+        return Pipeline<Source, T, decltype(chain), true>(source_, config_, std::move(chain));
+    }
+
+    /**
+     * Runs the pipeline and gathers its values. Without filters results are
+     * constructed in place as in process(); with filters they are
+     * compacted as in filter(), in config.order.
+     */
+    ProcessResult<T> collect() const {
+        using Item = decltype(source_[0]);
+        const Chain& chain = chain_;
+        if constexpr (Filtered) {
+            return detail::run_compact<T>(source_, config_, [&](size_t j) {
+                std::optional<T> out;
+                chain(source_[j], [&](auto&& value) {
+                    out.emplace(std::forward<decltype(value)>(value));
+                });
+                return out;
+            });
+        } else {
+            using In = std::decay_t<Item>;
+            return detail::dispatch<In, T>(source_, config_, [&](Item item) -> T {
+                std::optional<T> out;
+                chain(item, [&](auto&& value) {
+                    out.emplace(std::forward<decltype(value)>(value));
+                });
+                return std::move(*out);
+            });
+        }
+    }
+
+    /**
+     * Runs the pipeline and combines its values starting from identity
+     * (see declarative::reduce): values that pass the filters are combined
+     * in input order, so combine need not be commutative
+     */
+    template<typename Combine>
+    ReduceResult<T> reduce(T identity, Combine combine) const {
+        const Chain& chain = chain_;
+        return detail::run_reduce<T>(source_, config_,
+            [&](std::optional<T>& acc, size_t j) {
+                chain(source_[j], [&](auto&& value) {
+                    if (!acc) {
+                        acc.emplace(identity);
+                    }
+                    detail::accumulate(acc, std::forward<decltype(value)>(value), combine, config_);
+                });
+            },
+            combine, identity);
+    }
+
+    /**
+     * Runs the pipeline and combines its values in input order (see
+     * declarative::map_reduce); value-initialized if no value reaches the end
+     */
+    template<typename Combine>
+    ReduceResult<T> reduce(Combine combine) const {
+        const Chain& chain = chain_;
+        return detail::run_reduce<T>(source_, config_,
+            [&](std::optional<T>& acc, size_t j) {
+                chain(source_[j], [&](auto&& value) {
+                    detail::accumulate(acc, std::forward<decltype(value)>(value), combine, config_);
+                });
+            },
+            combine, T{});
+    }
+};
+
+/**
+ * Starts a lazy pipeline over a random-access range
+ *
+ * Example:
+ *   auto energy = declarative::pipeline(frames, config)
+ *       .map(extract_features)
+ *       .filter([](const Features& f) { return f.valid; })
+ *       .map([](const Features& f) { return f.energy; })
+ *       .reduce(0.0, std::plus<>());
+ */
+template<typename Range,
+         typename = std::enable_if_t<detail::is_random_access_range<Range>::value>>
+auto pipeline(const Range& input, const ProcessConfig& config = ProcessConfig{}) {
+    auto view = detail::view_of(input);
+    auto chain = [](auto&& item, auto&& sink) { sink(std::forward<decltype(item)>(item)); };
+    return Pipeline<decltype(view), detail::range_value_t<Range>, decltype(chain), false>(
+        view, config, std::move(chain));
+}
+
+/**
+ * Per-group aggregation for group_by_aggregate: every group starts from
+ * init, add(acc, item) folds an item in, and merge(acc, other) combines
+ * two partial aggregates of the same group (other may be moved from).
+ */
+template<typename Acc, typename Add, typename Merge>
+struct Aggregate {
+    Acc init;
+    Add add;
+    Merge merge;
+};
+
+template<typename Acc, typename Add, typename Merge>
+Aggregate<Acc, Add, Merge> aggregate(Acc init, Add add, Merge merge) {
+    return {std::move(init), std::move(add), std::move(merge)};
+}
+
+/**
+ * group_by_aggregate result: results holds one (key, aggregate) pair per
+ * group, in no particular order
+ */
+template<typename K, typename Acc>
+struct GroupResult : ProcessResult<std::pair<K, Acc>> {
+    size_t local_groups = 0;    // Entries over all per-thread tables
+    size_t largest_table = 0;   // Entries in the largest per-thread table
+    size_t partitions = 0;      // Key partitions merged in parallel (0 = merged serially)
+};
+
+namespace detail {
+
+// splitmix64 finalizer: spreads std::hash (the identity for integers)
+// over all bits, so low bits index tables and high bits pick partitions
+inline size_t mix_hash(size_t hash) {
+    uint64_t x = hash;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return static_cast<size_t>(x);
+}
+
+/**
+ * Open-addressing hash table (linear probing, load <= 1/2) over a dense
+ * entry array, so the groups are already compact for merging and output.
+ * Stores each entry's hash to skip key comparisons and rehashing.
+ */
+template<typename K, typename V>
+class GroupTable {
+private:
+    std::vector<std::pair<K, V>> entries_;
+    std::vector<size_t> hashes_;
+    std::vector<size_t> slots_;    // Entry index + 1; 0 = empty
+
+public:
+    size_t size() const noexcept { return entries_.size(); }
+    std::pair<K, V>& entry(size_t index) noexcept { return entries_[index]; }
+    size_t hash(size_t index) const noexcept { return hashes_[index]; }
+    std::vector<std::pair<K, V>>& entries() noexcept { return entries_; }
+
+    /**
+     * The value for key, added as make() if absent (inserted tells which)
+     */
+    template<typename KeyArg, typename Make>
+    V& find_or_add(KeyArg&& key, size_t hash, Make&& make, bool& inserted) {
+        if ((entries_.size() + 1) * 2 > slots_.size()) {
+            grow();
+        }
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            size_t slot = slots_[i];
+            if (slot == 0) {
+                hashes_.push_back(hash);
+                try {
+                    entries_.emplace_back(std::forward<KeyArg>(key), make());
+                } catch (...) {
+                    hashes_.pop_back();
+                    throw;
+                }
+                slots_[i] = entries_.size();
+                inserted = true;
+                return entries_.back().second;
+            }
+            if (hashes_[slot - 1] == hash && entries_[slot - 1].first == key) {
+                inserted = false;
+                return entries_[slot - 1].second;
+            }
+        }
+    }
+
+private:
+    void grow() {
+        slots_.assign(std::max(size_t(16), slots_.size() * 2), 0);
+        const size_t mask = slots_.size() - 1;
+        for (size_t e = 0; e < entries_.size(); ++e) {
+            size_t i = hashes_[e] & mask;
+            while (slots_[i] != 0) {
+                i = (i + 1) & mask;
+            }
+            slots_[i] = e + 1;
+        }
+    }
+};
+
+// Below this many entries over all thread tables, merge on one thread
+constexpr size_t GROUP_PARALLEL_MERGE_MIN = 4096;
+
+/**
+ * Counting-sorts entry indices 0..count-1 by part_of(index) < parts: order
+ * lists them grouped by partition, partition p at [bounds[p], bounds[p + 1])
+ */
+template<typename PartOf>
+void partition_entries(size_t count, size_t parts, PartOf&& part_of,
+                       std::vector<size_t>& order, std::vector<size_t>& bounds) {
+    bounds.assign(parts + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        ++bounds[part_of(i) + 1];
+    }
+    for (size_t p = 0; p < parts; ++p) {
+        bounds[p + 1] += bounds[p];
+    }
+    std::vector<size_t> next(bounds.begin(), bounds.end() - 1);
+    order.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        order[next[part_of(i)]++] = i;
+    }
+}
+
+} // namespace detail
+
+/**
+ * Parallel group-by: buckets items by key_fn(item) and folds each group
+ * with agg (see aggregate()). Each runner fills its own hash table; the
+ * tables are then merged. With many groups they are first radix-
+ * partitioned by key hash, and each partition is merged on its own thread
+ * into a partition table; otherwise they are merged on the calling
+ * thread. Keys need std::hash and ==. results lists every group once, in
+ * no particular order; GroupResult adds table-size metrics.
+ *
+ * Example:
+ *   struct Stats { size_t count = 0; double sum = 0; };
+ *   auto by_sensor = declarative::group_by_aggregate(points, config,
+ *       [](const DataPoint& p) { return p.sensor_id; },
+ *       declarative::aggregate(Stats{},
+ *           [](Stats& s, const DataPoint& p) { ++s.count; s.sum += p.value; },
+ *           [](Stats& s, const Stats& o) { s.count += o.count; s.sum += o.sum; }));
+ *   for (const auto& [sensor, stats] : by_sensor.results) { ... }
+ */
+template<typename Range, typename KeyFn, typename Acc, typename Add, typename Merge,
+         typename = std::enable_if_t<detail::is_random_access_range<Range>::value>>
+auto group_by_aggregate(
+    const Range& input,
+    const ProcessConfig& config,
+    KeyFn&& key_fn,
+    Aggregate<Acc, Add, Merge> agg
+) {
+    auto view = detail::view_of(input);
+    using K = std::decay_t<std::invoke_result_t<KeyFn&, decltype(view[0])>>;
+    using Entry = std::pair<K, Acc>;
+    using Table = detail::GroupTable<K, Acc>;
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    GroupResult<K, Acc> result;
+    const size_t n = view.size();
+    const size_t threads = detail::choose_threads(n, config);
+    std::vector<detail::PaddedSlot<Table>> locals(threads);
+    std::hash<K> hasher;
+    
+    auto make = [&]() { return agg.init; };
+    detail::run_items(n, threads, 1, config, result,
+        [&](size_t j, size_t slot) {
+            auto& table = locals[slot].value;
+            if (!table) {
+                table.emplace();
+            }
+            decltype(auto) item = view[j];
+            K key = key_fn(item);
+            size_t hash = detail::mix_hash(hasher(key));
+            bool inserted;
+            agg.add(table->find_or_add(std::move(key), hash, make, inserted), item);
+        },
+        [](size_t) {},
+        [](size_t, size_t) {},
+        [&](size_t j) { return detail::item_address(view, j); });
+    
+    std::vector<Table*> tables;
+    for (auto& local : locals) {
+        if (local.value) {
+            tables.push_back(&*local.value);
+            result.local_groups += local.value->size();
+            result.largest_table = std::max(result.largest_table, local.value->size());
+        }
+    }
+    
+    if (!result.exception) {
+        try {
+            auto merge_entry = [&](Table& into, Table& from, size_t index) {
+                Entry& entry = from.entry(index);
+                bool inserted;
+                Acc& acc = into.find_or_add(std::move(entry.first), from.hash(index),
+                    [&]() { return std::move(entry.second); }, inserted);
+                if (!inserted) {
+                    agg.merge(acc, std::move(entry.second));
+                }
+            };
+            
+            if (tables.size() > 1 && (threads == 1 || result.local_groups < detail::GROUP_PARALLEL_MERGE_MIN)) {
+                for (size_t t = 1; t < tables.size(); ++t) {
+                    for (size_t i = 0; i < tables[t]->size(); ++i) {
+                        merge_entry(*tables[0], *tables[t], i);
+                    }
+                }
+                tables.resize(1);
+            }
+            
+            if (tables.size() == 1) {
+                auto& entries = tables[0]->entries();
+                result.results.assign(std::make_move_iterator(entries.begin()),
+                                      std::make_move_iterator(entries.end()));
+            } else if (tables.size() > 1) {
+                // Radix-partition every table's entries by the hash's top
+                // bits: order[t] lists entry indices grouped by partition
+                const size_t parts = threads;
+                auto part_of = [&](size_t hash) {
+                    return (hash >> (sizeof(size_t) * 8 - 16)) % parts;
+                };
+                std::vector<std::vector<size_t>> order(tables.size());
+                std::vector<std::vector<size_t>> bounds(tables.size());
+                detail::run_chunks(tables.size(), config, [&](size_t t) {
+                    Table& table = *tables[t];
+                    detail::partition_entries(table.size(), parts,
+                        [&](size_t i) { return part_of(table.hash(i)); }, order[t], bounds[t]);
+                });
+                
+                std::vector<Table> merged(parts);
+                detail::run_chunks(parts, config, [&](size_t p) {
+                    for (size_t t = 0; t < tables.size(); ++t) {
+                        for (size_t k = bounds[t][p]; k < bounds[t][p + 1]; ++k) {
+                            merge_entry(merged[p], *tables[t], order[t][k]);
+                        }
+                    }
+                });
+                result.partitions = parts;
+                
+                std::vector<size_t> offsets(parts + 1, 0);
+                for (size_t p = 0; p < parts; ++p) {
+                    offsets[p + 1] = offsets[p] + merged[p].size();
+                }
+                detail::ResultSlots<Entry> slots(result.results, offsets[parts], config);
+                detail::run_chunks(parts, config, [&](size_t p) {
+                    auto& entries = merged[p].entries();
+                    slots.move_in(offsets[p], entries.begin(), entries.end());
+                    slots.add(offsets[p], offsets[p + 1]);
+                });
+                slots.keep();
+            }
+        } catch (...) {
+            result.exception = std::current_exception();
+        }
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    result.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    detail::settle(result, config);
+    return result;
+}
+
+/**
+ * histogram result: counts[b] items fell in bin b
+ */
+struct HistogramResult : ProcessMetrics {
+    std::vector<size_t> counts;
+    size_t out_of_range = 0;      // Items whose bin was < 0 or >= nbins (not counted)
+    bool sparse = false;          // Per-thread hash tables instead of dense bins
+};
+
+namespace detail {
+
+// Up to this many bins, each thread keeps HISTOGRAM_COPIES interleaved
+// copies so runs of equal bins do not serialize on one counter
+constexpr size_t HISTOGRAM_SMALL_BINS = 256;
+constexpr size_t HISTOGRAM_COPIES = 4;
+
+// Above this many bins, and more bins than items per thread, threads
+// count into hash tables instead of dense arrays
+constexpr size_t HISTOGRAM_DENSE_MAX_BINS = size_t(1) << 16;
+
+/**
+ * One thread's bins, on their own cache lines: a dense block of scratch
+ * storage (zeroed by the owning thread on first use) or a sparse table
+ */
+struct alignas(CACHE_LINE_SIZE) HistogramSlot {
+    size_t* bins = nullptr;
+    size_t dropped = 0;
+    GroupTable<size_t, size_t> sparse;
+};
+
+} // namespace detail
+
+/**
+ * Parallel histogram: counts items per bin_fn(item) in [0, nbins), with
+ * no atomics or locks. Each thread counts into private bins, padded to
+ * cache lines, which are merged afterwards:
+ *  - small nbins: several interleaved copies per thread, summed in
+ *    vectorizable loops;
+ *  - large nbins with few items per thread: per-thread hash tables of the
+ *    bins actually hit, radix-partitioned by bin and merged in parallel;
+ *  - otherwise: one dense array per thread, merged in parallel by bin
+ *    range.
+ * Dense bin storage is cached for reuse under MemoryPolicy::Pooled.
+ *
+ * Example:
+ *   auto hist = declarative::histogram(latencies_us, config,
+ *       [](double us) { return static_cast<long>(us / 10.0); }, 100);
+ */
+template<typename Range, typename BinFn,
+         typename = std::enable_if_t<detail::is_random_access_range<Range>::value>>
+HistogramResult histogram(
+    const Range& input,
+    const ProcessConfig& config,
+    BinFn&& bin_fn,
+    size_t nbins
+) {
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    auto view = detail::view_of(input);
+    using Bin = std::decay_t<std::invoke_result_t<BinFn&, decltype(view[0])>>;
+    static_assert(std::is_integral_v<Bin>, "histogram: bin_fn must return an integer");
+    
+    HistogramResult result;
+    const size_t n = view.size();
+    const size_t threads = detail::choose_threads(n, config);
+    const bool small = nbins <= detail::HISTOGRAM_SMALL_BINS;
+    result.sparse = nbins > detail::HISTOGRAM_DENSE_MAX_BINS && nbins > n / threads;
+    
+    const size_t copies = small ? detail::HISTOGRAM_COPIES : 1;
+    const size_t stride = detail::round_up(nbins * copies,
+                                           detail::CACHE_LINE_SIZE / sizeof(size_t));
+    const bool reuse = config.memory == MemoryPolicy::Pooled ||
+                       config.memory == MemoryPolicy::Preallocated;
+    detail::ScratchBuffer storage(result.sparse ? 0 : threads * stride * sizeof(size_t), reuse);
+    std::vector<detail::HistogramSlot> slots(threads);
+    
+    // Counts items [begin, end) into slot s, one tight loop per bin layout
+    auto count_range = [&](size_t begin, size_t end, size_t s) {
+        auto& slot = slots[s];
+        auto bin_of = [&](size_t j) {
+            Bin bin = bin_fn(view[j]);
+            if constexpr (std::is_signed_v<Bin>) {
+                if (bin < 0) {
+                    return nbins;
+                }
+            }
+            return static_cast<size_t>(bin) < nbins ? static_cast<size_t>(bin) : nbins;
+        };
+        if (result.sparse) {
+            for (size_t j = begin; j < end; ++j) {
+                size_t b = bin_of(j);
+                if (b == nbins) {
+                    ++slot.dropped;
+                    continue;
+                }
+                bool inserted;
+                ++slot.sparse.find_or_add(b, detail::mix_hash(b), [] { return size_t(0); }, inserted);
+            }
+            return;
+        }
+        if (!slot.bins) {
+            slot.bins = storage.as<size_t>() + s * stride;
+            std::fill(slot.bins, slot.bins + stride, size_t(0));
+        }
+        size_t* bins = slot.bins;
+        size_t dropped = 0;
+        if (small) {
+            // Consecutive items go to different copies, so a run of equal
+            // bins does not wait on each previous increment
+            const size_t copy_stride = nbins;
+            size_t j = begin;
+            for (; j + detail::HISTOGRAM_COPIES <= end; j += detail::HISTOGRAM_COPIES) {
+                for (size_t c = 0; c < detail::HISTOGRAM_COPIES; ++c) {
+                    size_t b = bin_of(j + c);
+                    if (b == nbins) {
+                        ++dropped;
+                    } else {
+                        ++bins[c * copy_stride + b];
+                    }
+                }
+            }
+            for (; j < end; ++j) {
+                size_t b = bin_of(j);
+                if (b == nbins) {
+                    ++dropped;
+                } else {
+                    ++bins[b];
+                }
+            }
+        } else {
+            for (size_t j = begin; j < end; ++j) {
+                size_t b = bin_of(j);
+                if (b == nbins) {
+                    ++dropped;
+                } else {
+                    ++bins[b];
+                }
+            }
+        }
+        slot.dropped += dropped;
+    };
+    
+    auto address = [&](size_t j) { return detail::item_address(view, j); };
+    if (config.on_error == ErrorPolicy::CollectAll) {
+        // One item per call, so a failure is recorded at its own index
+        detail::run_items(n, threads, 1, config, result,
+            [&](size_t j, size_t s) { count_range(j, j + 1, s); },
+            [](size_t) {}, [](size_t, size_t) {}, address);
+    } else {
+        detail::run_batches(n, threads, 1, config, result,
+            count_range, [](size_t, size_t) {}, address);
+    }
+    
+    for (const auto& slot : slots) {
+        result.out_of_range += slot.dropped;
+    }
+    
+    if (!result.exception) {
+        try {
+            result.counts.assign(nbins, 0);
+            size_t* counts = result.counts.data();
+            const size_t parts = nbins >= 4096 ? threads : 1;
+            const size_t range = (nbins + parts - 1) / parts;
+            
+            if (result.sparse) {
+                // Partition p merges bins [p * range, (p + 1) * range)
+                std::vector<std::vector<size_t>> order(threads);
+                std::vector<std::vector<size_t>> bounds(threads);
+                detail::run_chunks(threads, config, [&](size_t t) {
+                    auto& table = slots[t].sparse;
+                    detail::partition_entries(table.size(), parts,
+                        [&](size_t i) { return table.entry(i).first / range; }, order[t], bounds[t]);
+                });
+                detail::run_chunks(parts, config, [&](size_t p) {
+                    for (size_t t = 0; t < threads; ++t) {
+                        for (size_t k = bounds[t][p]; k < bounds[t][p + 1]; ++k) {
+                            const auto& entry = slots[t].sparse.entry(order[t][k]);
+                            counts[entry.first] += entry.second;
+                        }
+                    }
+                });
+            } else {
+                detail::run_chunks(parts, config, [&](size_t p) {
+                    const size_t begin = p * range;
+                    const size_t end = std::min(nbins, begin + range);
+                    for (const auto& slot : slots) {
+                        if (!slot.bins) {
+                            continue;
+                        }
+                        for (size_t c = 0; c < copies; ++c) {
+                            const size_t* bins = slot.bins + c * nbins;
+                            for (size_t b = begin; b < end; ++b) {
+                                counts[b] += bins[b];
+                            }
+                        }
+                    }
+                });
+            }
+        } catch (...) {
+            result.exception = std::current_exception();
+            result.counts.clear();
+        }
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    result.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    detail::settle(result, config);
+    return result;
+}
+
+namespace detail {
+
+// Parallel selection hands ranges of this size or less to std::nth_element
+constexpr size_t SELECT_SERIAL_MAX = size_t(1) << 14;
+constexpr size_t SELECT_SAMPLE = 31;
+
+/**
+ * Parallel quickselect over trivially copyable items: reorders [first,
+ * first + n) as std::nth_element(first, first + nth, first + n, comp)
+ * does. Each round takes the median of a pseudo-random sample as pivot,
+ * classifies every item of the live range in parallel blocks (comp runs
+ * once per item and round; the class is stored) and scatters the items by
+ * per-block offsets into less / equal / greater parts, alternating
+ * between the input and scratch. Parts left behind in scratch are copied
+ * home; the part holding nth stays live. A round that keeps more than 3/4
+ * of the range, or a range of SELECT_SERIAL_MAX items, finishes with
+ * std::nth_element. If comp throws the range is left a permutation of the
+ * input.
+ */
+template<typename T, typename Compare>
+void parallel_select(T* first, size_t n, size_t nth, size_t threads,
+                     const ProcessConfig& config, Compare& comp, bool reuse) {
+    static_assert(std::is_trivially_copyable_v<T>, "parallel_select: items must be trivially copyable");
+    
+    // Both arrays are indexed by input position
+    ScratchBuffer scratch(n * sizeof(T), reuse);
+    ScratchBuffer classes(n, reuse);
+    T* buffer = scratch.as<T>();
+    unsigned char* cls = classes.as<unsigned char>();
+    T* src = first;
+    T* dst = buffer;
+    
+    const size_t copy_block = std::max(config.chunk_size, (n + threads - 1) / threads);
+    auto copy_home = [&](size_t begin, size_t end) {
+        if (src == first || begin >= end) {
+            return;
+        }
+        run_chunks((end - begin + copy_block - 1) / copy_block, config, [&](size_t b) {
+            const size_t from = begin + b * copy_block;
+            const size_t to = std::min(end, from + copy_block);
+            std::copy(buffer + from, buffer + to, first + from);
+        });
+    };
+    
+    size_t lo = 0;
+    size_t hi = n;
+    uint64_t seed = n;
+    try {
+        while (hi - lo > SELECT_SERIAL_MAX) {
+            const size_t size = hi - lo;
+            
+            std::array<size_t, SELECT_SAMPLE> picks;
+            for (auto& pick : picks) {
+                seed = mix_hash(seed + 1);
+                pick = lo + seed % size;
+            }
+            std::nth_element(picks.begin(), picks.begin() + SELECT_SAMPLE / 2, picks.end(),
+                             [&](size_t a, size_t b) { return comp(src[a], src[b]); });
+            const T pivot = src[picks[SELECT_SAMPLE / 2]];
+            
+            const size_t block = std::max(config.chunk_size, (size + threads * 4 - 1) / (threads * 4));
+            const size_t blocks = (size + block - 1) / block;
+            std::vector<std::array<size_t, 3>> offsets(blocks);
+            
+            run_chunks(blocks, config, [&](size_t b) {
+                const size_t begin = lo + b * block;
+                const size_t end = std::min(hi, begin + block);
+                std::array<size_t, 3> count{};
+                for (size_t j = begin; j < end; ++j) {
+                    // 0 = less, 1 = equal, 2 = greater, without branches
+                    unsigned char c = static_cast<unsigned char>(
+                        1 + comp(pivot, src[j]) - comp(src[j], pivot));
+                    cls[j] = c;
+                    ++count[c];
+                }
+                offsets[b] = count;
+            });
+            
+            std::array<size_t, 3> total{};
+            for (const auto& count : offsets) {
+                for (size_t c = 0; c < 3; ++c) {
+                    total[c] += count[c];
+                }
+            }
+            std::array<size_t, 3> next{lo, lo + total[0], lo + total[0] + total[1]};
+            for (auto& offset : offsets) {
+                for (size_t c = 0; c < 3; ++c) {
+                    size_t count = offset[c];
+                    offset[c] = next[c];
+                    next[c] += count;
+                }
+            }
+            
+            run_chunks(blocks, config, [&](size_t b) {
+                const size_t begin = lo + b * block;
+                const size_t end = std::min(hi, begin + block);
+                auto offset = offsets[b];
+                for (size_t j = begin; j < end; ++j) {
+                    dst[offset[cls[j]]++] = src[j];
+                }
+            });
+            std::swap(src, dst);
+            
+            const size_t less_end = lo + total[0];
+            const size_t equal_end = less_end + total[1];
+            if (nth < less_end) {
+                copy_home(less_end, hi);
+                hi = less_end;
+            } else if (nth < equal_end) {
+                copy_home(lo, hi);
+                return;
+            } else {
+                copy_home(lo, equal_end);
+                lo = equal_end;
+            }
+            if ((hi - lo) * 4 > size * 3) {
+                break;
+            }
+        }
+    } catch (...) {
+        // The live range may be in scratch
+        copy_home(lo, hi);
+        throw;
+    }
+    copy_home(lo, hi);
+    std::nth_element(first + lo, first + nth, first + hi, comp);
+}
+
+/**
+ * Selection driver for nth_element and top_k: parallel_select when the
+ * items are contiguous and trivially copyable and the call has threads to
+ * spare, std::nth_element otherwise
+ */
+template<typename It, typename Compare>
+void run_select(It first, size_t n, size_t nth, const ProcessConfig& config,
+                Compare& comp, ProcessMetrics& metrics) {
+    using T = typename std::iterator_traits<It>::value_type;
+    size_t threads = choose_threads(n, config);
+    threads = std::max(size_t(1), std::min(threads, n / std::max(size_t(1), config.chunk_size)));
+    metrics.threads_used = threads;
+    if (nth >= n) {
+        return;
+    }
+    
+    if constexpr (std::is_pointer_v<It> && std::is_trivially_copyable_v<T>) {
+        if (threads > 1 && n > SELECT_SERIAL_MAX) {
+            const bool reuse = config.memory == MemoryPolicy::Pooled ||
+                               config.memory == MemoryPolicy::Preallocated;
+            parallel_select(first, n, nth, threads, config, comp, reuse);
+            return;
+        }
+    }
+    metrics.threads_used = 1;
+    std::nth_element(first, first + nth, first + n, comp);
+}
+
+} // namespace detail
+
+/**
+ * Parallel counterpart of std::nth_element on a random-access range:
+ * afterwards data[nth] is the item a full sort by comp would put there,
+ * no item before it compares greater and none after it compares less.
+ * Contiguous ranges of trivially copyable items use a parallel
+ * quickselect; other ranges run std::nth_element. nth >= size is a no-op.
+ * If comp throws, the call fails and the order of data is unspecified.
+ *
  * Example:
- *   auto result = declarative::process(data, {
- *       .memory = MemoryPolicy::Pooled,
- *       .concurrency = ConcurrencyPolicy::Adaptive,
- *       .safety = SafetyPolicy::Guaranteed
- *   }, [](int x) { return x * 2; });
+ *   declarative::nth_element(latencies, config, latencies.size() * 99 / 100);
+ *   double p99 = latencies[latencies.size() * 99 / 100];
  */
-template<typename InputT, typename OutputT = InputT, typename Func>
-ProcessResult<OutputT> process(
-    const std::vector<InputT>& input,
+template<typename Range, typename Compare = std::less<>,
+         typename = std::enable_if_t<detail::is_random_access_range<std::decay_t<Range>>::value>>
+ProcessMetrics nth_element(
+    Range&& data,
     const ProcessConfig& config,
-    Func&& func
+    size_t nth,
+    Compare comp = Compare{}
 ) {
-    // Dispatch based on concurrency policy
-    switch (config.concurrency) {
-        case ConcurrencyPolicy::Sequential:
-            return process_sequential<InputT, OutputT>(
-                input, std::forward<Func>(func), config
-            );
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    ProcessMetrics metrics;
+    const size_t n = static_cast<size_t>(std::size(data));
+    try {
+        if constexpr (detail::is_contiguous_range<std::decay_t<Range>>::value) {
+            detail::run_select(data.data(), n, nth, config, comp, metrics);
+        } else {
+            detail::run_select(std::begin(data), n, nth, config, comp, metrics);
+        }
+        metrics.items_processed = n;
+    } catch (...) {
+        metrics.exception = std::current_exception();
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    metrics.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    detail::settle(metrics, config);
+    return metrics;
+}
+
+/**
+ * top_k result: the k best items in rank order, with their scores and
+ * input positions
+ */
+template<typename T, typename S>
+struct TopKResult : ProcessResult<T> {
+    std::vector<S> scores;            // scores[i] is results[i]'s score
+    std::vector<size_t> indices;      // Input position of results[i]
+};
+
+namespace detail {
+
+// Up to this k, top_k keeps a bounded heap per runner; above it (with
+// trivially copyable scores) it scores every item and selects in parallel
+constexpr size_t TOPK_HEAP_MAX = 1024;
+
+template<typename S>
+struct Candidate {
+    S score;
+    size_t index;
+};
+
+} // namespace detail
+
+/**
+ * The k items with the best score_fn(item), best first: comp(a, b) means
+ * score a ranks before b (the default std::greater<> keeps the highest
+ * scores). Equal scores rank by input position, so the answer does not
+ * depend on thread count. Scoring is fused into the selection:
+ *  - small k: each runner keeps a bounded heap of its k best (score,
+ *    position) pairs; the heaps are merged at the end, and scores of
+ *    items that do not make a heap are never stored;
+ *  - large k: (score, position) pairs are built in parallel, partitioned
+ *    around rank k by a parallel quickselect, and the k best are sorted
+ *    in parallel.
+ * Only the k winners are copied into results. Under CollectAll, items
+ * whose score_fn throws are left out.
+ *
+ * Example:
+ *   auto best = declarative::top_k(documents, config, 10,
+ *       [&](const Document& d) { return relevance(d, query); });
+ */
+template<typename Range, typename ScoreFn, typename Compare = std::greater<>,
+         typename = std::enable_if_t<detail::is_random_access_range<Range>::value>>
+auto top_k(
+    const Range& input,
+    const ProcessConfig& config,
+    size_t k,
+    ScoreFn&& score_fn,
+    Compare comp = Compare{}
+) {
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    auto view = detail::view_of(input);
+    using T = std::decay_t<decltype(view[0])>;
+    using S = std::decay_t<std::invoke_result_t<ScoreFn&, decltype(view[0])>>;
+    using Candidate = detail::Candidate<S>;
+    
+    TopKResult<T, S> result;
+    const size_t n = view.size();
+    k = std::min(k, n);
+    
+    auto better = [&comp](const Candidate& a, const Candidate& b) {
+        if (comp(a.score, b.score)) {
+            return true;
+        }
+        return !comp(b.score, a.score) && a.index < b.index;
+    };
+    auto address = [&](size_t j) { return detail::item_address(view, j); };
+    std::vector<Candidate> winners;
+    bool selected = false;
+    
+    if constexpr (std::is_trivially_copyable_v<S>) {
+        if (k > detail::TOPK_HEAP_MAX && config.on_error != ErrorPolicy::CollectAll) {
+            selected = true;
+            const size_t threads = detail::choose_threads(n, config);
+            const bool reuse = config.memory == MemoryPolicy::Pooled ||
+                               config.memory == MemoryPolicy::Preallocated;
+            detail::ScratchBuffer scratch(n * sizeof(Candidate), reuse);
+            Candidate* candidates = scratch.as<Candidate>();
+            
+            detail::run_batches(n, threads, detail::cache_line_step(sizeof(Candidate)), config, result,
+                [&](size_t begin, size_t end) {
+                    for (size_t j = begin; j < end; ++j) {
+                        new (&candidates[j]) Candidate{score_fn(view[j]), j};
+                    }
+                },
+                [](size_t, size_t) {}, address);
+            
+            if (!result.exception) {
+                try {
+                    // Selection and sort report into their own metrics, so
+                    // the item count above stands
+                    ProcessConfig capture = config;
+                    capture.on_error = ErrorPolicy::Capture;
+                    ProcessMetrics select;
+                    detail::run_select(candidates, n, k, capture, better, select);
+                    std::nullptr_t no_bits = nullptr;
+                    auto sorted = detail::run_sort(candidates, k, capture, better, no_bits, false);
+                    if (sorted.exception) {
+                        std::rethrow_exception(sorted.exception);
+                    }
+                    winners.assign(candidates, candidates + k);
+                } catch (...) {
+                    result.exception = std::current_exception();
+                }
+            }
+        }
+    }
+    
+    if (!selected) {
+        const size_t threads = detail::choose_threads(n, config);
+        std::vector<detail::PaddedSlot<std::vector<Candidate>>> heaps(threads);
         
-        case ConcurrencyPolicy::Parallel:
-        case ConcurrencyPolicy::ThreadPool:
-            return process_parallel<InputT, OutputT>(
-                input, std::forward<Func>(func), config
-            );
+        // The worst of a runner's k candidates sits at the front of its heap
+        auto scan_range = [&](size_t begin, size_t end, size_t s) {
+            auto& slot = heaps[s].value;
+            if (!slot) {
+                slot.emplace();
+                slot->reserve(k);
+            }
+            auto& heap = *slot;
+            for (size_t j = begin; j < end; ++j) {
+                Candidate candidate{score_fn(view[j]), j};
+                if (heap.size() < k) {
+                    heap.push_back(std::move(candidate));
+                    std::push_heap(heap.begin(), heap.end(), better);
+                } else if (better(candidate, heap.front())) {
+                    std::pop_heap(heap.begin(), heap.end(), better);
+                    heap.back() = std::move(candidate);
+                    std::push_heap(heap.begin(), heap.end(), better);
+                }
+            }
+        };
         
-        case ConcurrencyPolicy::Adaptive:
-        default:
-            return process_adaptive<InputT, OutputT>(
-                input, std::forward<Func>(func), config
-            );
+        if (k > 0) {
+            if (config.on_error == ErrorPolicy::CollectAll) {
+                detail::run_items(n, threads, 1, config, result,
+                    [&](size_t j, size_t s) { scan_range(j, j + 1, s); },
+                    [](size_t) {}, [](size_t, size_t) {}, address);
+            } else {
+                detail::run_batches(n, threads, 1, config, result,
+                    scan_range, [](size_t, size_t) {}, address);
+            }
+        }
+        
+        if (!result.exception) {
+            try {
+                for (auto& slot : heaps) {
+                    if (slot.value) {
+                        std::move(slot.value->begin(), slot.value->end(), std::back_inserter(winners));
+                    }
+                }
+                if (winners.size() > k) {
+                    std::nth_element(winners.begin(), winners.begin() + k, winners.end(), better);
+                    winners.erase(winners.begin() + k, winners.end());
+                }
+                std::sort(winners.begin(), winners.end(), better);
+            } catch (...) {
+                result.exception = std::current_exception();
+            }
+        }
+    }
+    
+    if (!result.exception) {
+        try {
+            result.results.reserve(winners.size());
+            result.scores.reserve(winners.size());
+            result.indices.reserve(winners.size());
+            for (auto& winner : winners) {
+                result.results.push_back(view[winner.index]);
+                result.scores.push_back(std::move(winner.score));
+                result.indices.push_back(winner.index);
+            }
+        } catch (...) {
+            result.exception = std::current_exception();
+        }
     }
+    if (result.exception) {
+        result.results.clear();
+        result.scores.clear();
+        result.indices.clear();
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    result.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
+    
+    detail::settle(result, config);
+    return result;
 }
 
 /**
- * Simplified API with default config
+ * hash_join result: one combined value per matching (build, probe) pair
  */
-template<typename InputT, typename Func>
-auto process(const std::vector<InputT>& input, Func&& func) {
-    return process<InputT, 
-                   std::invoke_result_t<Func, InputT>>(
-        input, 
-        ProcessConfig{}, 
-        std::forward<Func>(func)
-    );
-}
+template<typename T>
+struct JoinResult : ProcessResult<T> {
+    size_t build_rows = 0;            // Rows in the build table
+    size_t partitions = 1;            // Radix partitions of the build table
+    bool partitioned_probe = false;   // Probe side radix-partitioned too (Unordered)
+};
 
-// ============================================================================
-// SECTION 5: UTILITIES
-// ============================================================================
+namespace detail {
+
+// A radix partition's table aims at this many rows (hash, index and slots
+// about 128 KiB, so it stays in L2 while it is built and probed)
+constexpr size_t JOIN_PARTITION_ROWS = 4096;
+
+// Partitioning starts at this many build rows; fan-out stops at
+// 2^JOIN_MAX_RADIX_BITS so one scatter pass stays TLB-friendly
+constexpr size_t JOIN_PARTITION_MIN = 16384;
+constexpr unsigned JOIN_MAX_RADIX_BITS = 10;
+
+struct HashedRow {
+    size_t hash;
+    size_t index;
+};
+
+inline size_t radix_part(size_t hash, unsigned bits) {
+    return bits == 0 ? 0 : hash >> (sizeof(size_t) * 8 - bits);
+}
 
 /**
- * Benchmark helper - compare strategies
+ * Hashes items 0..n-1 into rows[i] = {hash_of(i), i}, then radix-
+ * partitions them into out by the top bits of the hash, keeping input
+ * order within each partition: partition p is out[bounds[p], bounds[p + 1]).
+ * Per-block counts are scanned into per-block offsets, so neither pass
+ * shares a write position.
  */
-template<typename InputT, typename Func>
-struct BenchmarkResult {
-    double sequential_ms;
-    double parallel_ms;
-    double adaptive_ms;
-    double speedup_parallel;
-    double speedup_adaptive;
-    size_t optimal_threads;
-};
+template<typename HashOf>
+void hash_partition(size_t n, unsigned bits, HashOf& hash_of, HashedRow* rows, HashedRow* out,
+                    std::vector<size_t>& bounds, size_t threads, const ProcessConfig& config) {
+    const size_t parts = size_t(1) << bits;
+    const size_t block = threads == 1
+        ? std::max(size_t(1), n)
+        : std::max(config.chunk_size, (n + threads * 4 - 1) / (threads * 4));
+    const size_t blocks = (n + block - 1) / block;
+    std::vector<size_t> offsets(blocks * parts, 0);
+    
+    run_chunks(blocks, config, [&](size_t b) {
+        const size_t end = std::min(n, (b + 1) * block);
+        size_t* count = offsets.data() + b * parts;
+        for (size_t i = b * block; i < end; ++i) {
+            size_t hash = hash_of(i);
+            rows[i] = HashedRow{hash, i};
+            ++count[radix_part(hash, bits)];
+        }
+    });
+    
+    bounds.assign(parts + 1, 0);
+    size_t next = 0;
+    for (size_t p = 0; p < parts; ++p) {
+        bounds[p] = next;
+        for (size_t b = 0; b < blocks; ++b) {
+            size_t count = offsets[b * parts + p];
+            offsets[b * parts + p] = next;
+            next += count;
+        }
+    }
+    bounds[parts] = next;
+    
+    run_chunks(blocks, config, [&](size_t b) {
+        const size_t end = std::min(n, (b + 1) * block);
+        size_t* offset = offsets.data() + b * parts;
+        for (size_t i = b * block; i < end; ++i) {
+            out[offset[radix_part(rows[i].hash, bits)]++] = rows[i];
+        }
+    });
+}
 
-template<typename InputT, typename Func>
-BenchmarkResult<InputT, Func> benchmark(
-    const std::vector<InputT>& input,
-    Func&& func,
-    size_t iterations = 3
+} // namespace detail
+
+/**
+ * Parallel inner hash join: for every probe item p and every build item b
+ * with build_key(b) == probe_key(p), results holds combine(b, p). The
+ * table is built in parallel on the library executor without locks:
+ * build keys are hashed and radix-partitioned by the top hash bits, and
+ * each partition gets its own small open-addressing table (sized to stay
+ * in cache), built by one thread. Probes then run in parallel, each
+ * reading only its key's partition table.
+ *
+ * Under OrderPolicy::Preserve results follow probe order, and a probe's
+ * matches follow build order. Under Unordered with a partitioned table the
+ * probe side is radix-partitioned as well, so each thread probes one
+ * cache-resident table at a time, and results come in partition order.
+ *
+ * Keys need std::hash and ==, and both key functions must return the same
+ * type; build_key is called again to confirm hash matches, so it should be
+ * cheap (typically a member). A throwing build_key fails the call; under
+ * CollectAll, probe items whose key or combine throws are left out, and
+ * errors index the probe input.
+ *
+ * Example:
+ *   auto enriched = declarative::hash_join(customers, events, config,
+ *       [](const Customer& c) { return c.id; },
+ *       [](const Event& e) { return e.customer_id; },
+ *       [](const Customer& c, const Event& e) { return Enriched{e, c.region}; });
+ */
+template<typename BuildRange, typename ProbeRange, typename BuildKey, typename ProbeKey,
+         typename Combine,
+         typename = std::enable_if_t<detail::is_random_access_range<BuildRange>::value &&
+                                     detail::is_random_access_range<ProbeRange>::value>>
+auto hash_join(
+    const BuildRange& build,
+    const ProbeRange& probe,
+    const ProcessConfig& config,
+    BuildKey&& build_key,
+    ProbeKey&& probe_key,
+    Combine&& combine
 ) {
-    BenchmarkResult<InputT, Func> result{};
+    auto start = std::chrono::high_resolution_clock::now();
     
-    // Sequential baseline
-    {
-        double total = 0.0;
-        for (size_t i = 0; i < iterations; ++i) {
-            auto r = process_sequential<InputT, 
-                                       std::invoke_result_t<Func, InputT>>(
-                input, func, ProcessConfig{}
-            );
-            total += r.execution_time_ms;
+    auto build_view = detail::view_of(build);
+    auto probe_view = detail::view_of(probe);
+    using K = std::decay_t<std::invoke_result_t<BuildKey&, decltype(build_view[0])>>;
+    static_assert(std::is_same_v<K, std::decay_t<std::invoke_result_t<ProbeKey&, decltype(probe_view[0])>>>,
+                  "hash_join: build_key and probe_key must return the same type");
+    using Out = std::decay_t<std::invoke_result_t<Combine&, decltype(build_view[0]), decltype(probe_view[0])>>;
+    using detail::HashedRow;
+    
+    JoinResult<Out> result;
+    const size_t nb = build_view.size();
+    const size_t np = probe_view.size();
+    const size_t build_threads = detail::choose_threads(nb, config);
+    const bool reuse = config.memory == MemoryPolicy::Pooled ||
+                       config.memory == MemoryPolicy::Preallocated;
+    result.build_rows = nb;
+    
+    unsigned bits = 0;
+    if (nb >= detail::JOIN_PARTITION_MIN) {
+        while (bits < detail::JOIN_MAX_RADIX_BITS &&
+               ((nb >> bits) > detail::JOIN_PARTITION_ROWS || (size_t(1) << bits) < build_threads)) {
+            ++bits;
         }
-        result.sequential_ms = total / iterations;
     }
+    const size_t parts = size_t(1) << bits;
+    result.partitions = parts;
     
-    // Parallel
-    {
-        double total = 0.0;
-        ProcessConfig config;
-        config.concurrency = ConcurrencyPolicy::Parallel;
+    // Partition p's table is slots[slot_base[p], slot_base[p + 1]), rows
+    // stored inline with index + 1 (0 = empty slot)
+    std::vector<size_t> slot_base(parts + 1, 0);
+    std::optional<detail::ScratchBuffer> slot_storage;
+    HashedRow* slots = nullptr;
+    
+    try {
+        detail::ScratchBuffer row_storage(2 * nb * sizeof(HashedRow), reuse);
+        HashedRow* rows = row_storage.as<HashedRow>() + nb;
+        std::vector<size_t> bounds;
+        auto build_hash = [&](size_t i) {
+            return detail::mix_hash(std::hash<K>{}(build_key(build_view[i])));
+        };
+        detail::hash_partition(nb, bits, build_hash, row_storage.as<HashedRow>(), rows,
+                               bounds, build_threads, config);
         
-        for (size_t i = 0; i < iterations; ++i) {
-            auto r = process_parallel<InputT, 
-                                     std::invoke_result_t<Func, InputT>>(
-                input, func, config
-            );
-            total += r.execution_time_ms;
-            result.optimal_threads = r.threads_used;
+        for (size_t p = 0; p < parts; ++p) {
+            const size_t count = bounds[p + 1] - bounds[p];
+            size_t size = count == 0 ? 0 : 2;
+            while (size < count * 2) {
+                size *= 2;
+            }
+            slot_base[p + 1] = slot_base[p] + size;
         }
-        result.parallel_ms = total / iterations;
+        slot_storage.emplace(slot_base[parts] * sizeof(HashedRow), reuse);
+        slots = slot_storage->as<HashedRow>();
+        
+        // Each partition's table is zeroed and filled by the thread that
+        // builds it; rows go in build order, so equal keys probe in order
+        const size_t groups = build_threads == 1 ? 1 : std::min(parts, build_threads * 4);
+        detail::run_chunks(groups, config, [&](size_t g) {
+            for (size_t p = g * parts / groups; p < (g + 1) * parts / groups; ++p) {
+                HashedRow* table = slots + slot_base[p];
+                const size_t size = slot_base[p + 1] - slot_base[p];
+                std::fill(table, table + size, HashedRow{0, 0});
+                for (size_t r = bounds[p]; r < bounds[p + 1]; ++r) {
+                    size_t i = rows[r].hash & (size - 1);
+                    while (table[i].index != 0) {
+                        i = (i + 1) & (size - 1);
+                    }
+                    table[i] = HashedRow{rows[r].hash, rows[r].index + 1};
+                }
+            }
+        });
+    } catch (...) {
+        result.exception = std::current_exception();
     }
     
-    // Adaptive
-    {
-        double total = 0.0;
-        for (size_t i = 0; i < iterations; ++i) {
-            auto r = process_adaptive<InputT, 
-                                     std::invoke_result_t<Func, InputT>>(
-                input, func, ProcessConfig{}
-            );
-            total += r.execution_time_ms;
+    // Calls on_match(build index) for each build row matching key, in
+    // build order
+    auto for_each_match = [&](size_t hash, const K& key, auto&& on_match) {
+        const size_t p = detail::radix_part(hash, bits);
+        const size_t size = slot_base[p + 1] - slot_base[p];
+        if (size == 0) {
+            return;
+        }
+        const HashedRow* table = slots + slot_base[p];
+        for (size_t i = hash & (size - 1); table[i].index != 0; i = (i + 1) & (size - 1)) {
+            const size_t b = table[i].index - 1;
+            if (table[i].hash == hash && build_key(build_view[b]) == key) {
+                on_match(b);
+            }
+        }
+    };
+    
+    if (!result.exception) {
+        result.partitioned_probe = parts > 1 && config.order == OrderPolicy::Unordered &&
+                                   config.on_error != ErrorPolicy::CollectAll;
+        if (result.partitioned_probe) {
+            // Probe rows grouped by partition, so consecutive probes share
+            // one cache-resident table
+            detail::ScratchBuffer probe_storage(2 * np * sizeof(HashedRow), reuse);
+            HashedRow* probe_rows = probe_storage.as<HashedRow>() + np;
+            std::vector<size_t> probe_bounds;
+            try {
+                auto probe_hash = [&](size_t j) {
+                    return detail::mix_hash(std::hash<K>{}(probe_key(probe_view[j])));
+                };
+                detail::hash_partition(np, bits, probe_hash, probe_storage.as<HashedRow>(), probe_rows,
+                                       probe_bounds, detail::choose_threads(np, config), config);
+            } catch (...) {
+                result.exception = std::current_exception();
+            }
+            if (!result.exception) {
+                detail::run_expand<Out>(np, config, result,
+                    [&](size_t q, auto&& emit) {
+                        const auto& item = probe_view[probe_rows[q].index];
+                        const K key = probe_key(item);
+                        for_each_match(probe_rows[q].hash, key, [&](size_t b) {
+                            emit(combine(build_view[b], item));
+                        });
+                    },
+                    [&](size_t q) { return detail::item_address(probe_view, probe_rows[q].index); });
+            }
+        } else {
+            detail::run_expand<Out>(np, config, result,
+                [&](size_t j, auto&& emit) {
+                    const auto& item = probe_view[j];
+                    const K key = probe_key(item);
+                    for_each_match(detail::mix_hash(std::hash<K>{}(key)), key, [&](size_t b) {
+                        emit(combine(build_view[b], item));
+                    });
+                },
+                [&](size_t j) { return detail::item_address(probe_view, j); });
         }
-        result.adaptive_ms = total / iterations;
     }
     
-    result.speedup_parallel = result.sequential_ms / result.parallel_ms;
-    result.speedup_adaptive = result.sequential_ms / result.adaptive_ms;
+    auto end = std::chrono::high_resolution_clock::now();
+    result.execution_time_ms = 
+        std::chrono::duration<double, std::milli>(end - start).count();
     
+    detail::settle(result, config);
     return result;
 }
 
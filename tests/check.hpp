@@ -0,0 +1,45 @@
+/**
+ * Minimal assertions for the test programs: the library has no
+ * dependencies, so neither do its tests. A failed CHECK prints its
+ * location and makes the program exit with status 1.
+ */
+
+#ifndef DECLARATIVE_COMPUTE_TESTS_CHECK_HPP
+#define DECLARATIVE_COMPUTE_TESTS_CHECK_HPP
+
+#include <iostream>
+
+namespace check {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline void fail(const char* expr, const char* file, int line) {
+    std::cerr << file << ":" << line << ": CHECK(" << expr << ") failed\n";
+    ++failures();
+}
+
+inline int report(const char* name) {
+    if (failures() == 0) {
+        std::cout << name << ": passed\n";
+        return 0;
+    }
+    std::cout << name << ": " << failures() << " check(s) failed\n";
+    return 1;
+}
+
+} // namespace check
+
+#define CHECK(expr) \
+    do { if (!(expr)) check::fail(#expr, __FILE__, __LINE__); } while (0)
+
+#define CHECK_THROWS(expr) \
+    do { \
+        bool thrown_ = false; \
+        try { (void)(expr); } catch (...) { thrown_ = true; } \
+        if (!thrown_) check::fail(#expr " throws", __FILE__, __LINE__); \
+    } while (0)
+
+#endif // DECLARATIVE_COMPUTE_TESTS_CHECK_HPP
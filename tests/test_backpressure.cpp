@@ -0,0 +1,84 @@
+/**
+ * BackpressurePolicy on a full lock-free submission queue: Block, Spin
+ * and RunInline run every task, Reject refuses enqueue() and fails the
+ * future from submit()
+ */
+
+#include "declarative_compute.hpp"
+#include "check.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace declarative;
+
+static ThreadPoolConfig bounded(BackpressurePolicy policy, size_t threads) {
+    ThreadPoolConfig config;
+    config.threads = threads;
+    config.submission = SubmissionQueue::LockFree;
+    config.queue_capacity = 4;
+    config.backpressure = policy;
+    return config;
+}
+
+static void test_every_task_runs() {
+    for (auto policy : {BackpressurePolicy::Block, BackpressurePolicy::Spin,
+                        BackpressurePolicy::RunInline}) {
+        ThreadPool pool(bounded(policy, 3));
+        std::atomic<long> ran{0};
+        std::vector<std::thread> producers;
+        for (int p = 0; p < 4; ++p) {
+            producers.emplace_back([&] {
+                for (int i = 0; i < 5000; ++i) {
+                    pool.enqueue([&] { ran.fetch_add(1); });
+                }
+            });
+        }
+        for (auto& producer : producers) {
+            producer.join();
+        }
+        pool.wait_all();
+        CHECK(ran.load() == 20000);
+        CHECK(pool.queued() == 0);
+    }
+}
+
+static void test_reject() {
+    ThreadPool pool(bounded(BackpressurePolicy::Reject, 1));
+    std::atomic<bool> release{false};
+    std::atomic<int> ran{0};
+    
+    // Occupy the only worker so the queue fills up
+    auto blocker = pool.submit([&] {
+        while (!release) std::this_thread::yield();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    
+    int accepted = 0;
+    for (int i = 0; i < 10; ++i) {
+        accepted += pool.enqueue([&] { ++ran; }) ? 1 : 0;
+    }
+    CHECK(accepted == 4);
+    
+    std::vector<TaskFuture<int>> futures;
+    for (int i = 0; i < 4; ++i) {
+        futures.push_back(pool.submit([] { return 1; }));
+    }
+    
+    release = true;
+    blocker.get();
+    for (auto& future : futures) {
+        CHECK_THROWS(future.get());
+    }
+    pool.wait_all();
+    CHECK(ran.load() == 4);
+}
+
+int main() {
+    test_every_task_runs();
+    test_reject();
+    return check::report("test_backpressure");
+}
@@ -0,0 +1,99 @@
+/**
+ * ErrorPolicy: Capture reports the failure in the result, Rethrow throws
+ * the original exception, CollectAll runs every item and lists each
+ * failure by index
+ */
+
+#include "declarative_compute.hpp"
+#include "check.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+using namespace declarative;
+
+static std::vector<int> iota(size_t n) {
+    std::vector<int> v(n);
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = static_cast<int>(i);
+    }
+    return v;
+}
+
+static ProcessConfig parallel(ErrorPolicy policy) {
+    ProcessConfig config;
+    config.concurrency = ConcurrencyPolicy::Parallel;
+    config.max_threads = 4;
+    config.chunk_size = 64;
+    config.on_error = policy;
+    return config;
+}
+
+static int fail_every_thousandth(int x) {
+    if (x % 1000 == 999) {
+        throw std::runtime_error("bad item");
+    }
+    return x * 2;
+}
+
+static void test_capture() {
+    const auto input = iota(10000);
+    auto result = process(input, parallel(ErrorPolicy::Capture), fail_every_thousandth);
+    CHECK(!result.success);
+    CHECK(result.exception != nullptr);
+    CHECK(result.error_message == "bad item");
+    
+    auto clean = process(input, parallel(ErrorPolicy::Capture), [](int x) { return x + 1; });
+    CHECK(clean.success);
+    CHECK(!clean.exception);
+    CHECK(clean.errors.empty());
+}
+
+static void test_rethrow() {
+    const auto input = iota(10000);
+    bool caught = false;
+    try {
+        process(input, parallel(ErrorPolicy::Rethrow), fail_every_thousandth);
+    } catch (const std::runtime_error& e) {
+        caught = std::string(e.what()) == "bad item";
+    }
+    CHECK(caught);
+    
+    CHECK_THROWS(filter(input, parallel(ErrorPolicy::Rethrow), [](int x) {
+        if (x == 4321) throw std::logic_error("bad predicate");
+        return true;
+    }));
+}
+
+static void test_collect_all() {
+    const auto input = iota(10000);
+    auto result = process(input, parallel(ErrorPolicy::CollectAll), fail_every_thousandth);
+    CHECK(!result.success);
+    CHECK(result.results.size() == input.size());
+    CHECK(result.errors.size() == 10);
+    for (size_t k = 0; k < result.errors.size(); ++k) {
+        CHECK(result.errors[k].index == 1000 * k + 999);
+        CHECK(result.errors[k].message == "bad item");
+    }
+    bool others_ran = true;
+    for (size_t i = 0; i < input.size(); ++i) {
+        if (i % 1000 != 999) {
+            others_ran = others_ran && result.results[i] == input[i] * 2;
+        }
+    }
+    CHECK(others_ran);
+    
+    auto kept = filter(input, parallel(ErrorPolicy::CollectAll), [](int x) {
+        if (x % 1000 == 0) throw std::runtime_error("bad predicate");
+        return x % 2 == 0;
+    });
+    CHECK(kept.errors.size() == 10);
+    CHECK(kept.results.size() == 4990);
+}
+
+int main() {
+    test_capture();
+    test_rethrow();
+    test_collect_all();
+    return check::report("test_errors");
+}
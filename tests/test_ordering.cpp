@@ -0,0 +1,107 @@
+/**
+ * Result ordering: results[i] belongs to input[i] under every
+ * concurrency policy and partitioner, and filter keeps input order
+ */
+
+#include "declarative_compute.hpp"
+#include "check.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace declarative;
+
+static std::vector<int> iota(size_t n) {
+    std::vector<int> v(n);
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = static_cast<int>(i);
+    }
+    return v;
+}
+
+static void test_process_order() {
+    const auto input = iota(100003);
+    for (auto concurrency : {ConcurrencyPolicy::Sequential, ConcurrencyPolicy::Parallel,
+                             ConcurrencyPolicy::Adaptive, ConcurrencyPolicy::ThreadPool}) {
+        for (auto partitioner : {Partitioner::Static, Partitioner::Dynamic,
+                                 Partitioner::Guided, Partitioner::Auto}) {
+            ProcessConfig config;
+            config.concurrency = concurrency;
+            config.partitioner = partitioner;
+            config.max_threads = 4;
+            config.chunk_size = 257;
+            
+            auto result = process<int, std::string>(input, config,
+                [](int x) { return std::to_string(x); });
+            CHECK(result.success);
+            CHECK(result.results.size() == input.size());
+            bool ordered = true;
+            for (size_t i = 0; i < input.size(); ++i) {
+                ordered = ordered && result.results[i] == std::to_string(input[i]);
+            }
+            CHECK(ordered);
+        }
+    }
+}
+
+static void test_batch_order() {
+    const auto input = iota(50000);
+    ProcessConfig config;
+    config.concurrency = ConcurrencyPolicy::Parallel;
+    config.max_threads = 4;
+    config.chunk_size = 100;
+    
+    auto result = process_batch<long>(input, config,
+        [](Span<const int> in, Span<long> out) {
+            for (size_t i = 0; i < in.size(); ++i) {
+                out[i] = 3L * in[i];
+            }
+        });
+    CHECK(result.success);
+    CHECK(result.results.size() == input.size());
+    bool ordered = true;
+    for (size_t i = 0; i < input.size(); ++i) {
+        ordered = ordered && result.results[i] == 3L * input[i];
+    }
+    CHECK(ordered);
+}
+
+static void test_filter_order() {
+    const auto input = iota(100003);
+    for (auto order : {OrderPolicy::Preserve, OrderPolicy::Unordered}) {
+        ProcessConfig config;
+        config.concurrency = ConcurrencyPolicy::Parallel;
+        config.max_threads = 4;
+        config.order = order;
+        
+        auto kept = filter(input, config, [](int x) { return x % 3 == 0; });
+        CHECK(kept.success);
+        CHECK(kept.results.size() == 33335);
+        bool ordered = true;
+        for (size_t i = 0; i < kept.results.size(); ++i) {
+            ordered = ordered && kept.results[i] == static_cast<int>(3 * i);
+        }
+        CHECK(ordered);
+        
+        auto mapped = filter_map(input, config, [](int x) -> std::optional<int> {
+            if (x % 5 != 0) return std::nullopt;
+            return x / 5;
+        });
+        CHECK(mapped.success);
+        CHECK(mapped.results.size() == 20001);
+        if (order == OrderPolicy::Preserve) {
+            bool in_order = true;
+            for (size_t i = 0; i < mapped.results.size(); ++i) {
+                in_order = in_order && mapped.results[i] == static_cast<int>(i);
+            }
+            CHECK(in_order);
+        }
+    }
+}
+
+int main() {
+    test_process_order();
+    test_batch_order();
+    test_filter_order();
+    return check::report("test_ordering");
+}
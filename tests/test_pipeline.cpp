@@ -0,0 +1,84 @@
+/**
+ * Pipeline: fused map/filter chains match the equivalent eager calls
+ */
+
+#include "declarative_compute.hpp"
+#include "check.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace declarative;
+
+static void test_collect() {
+    std::vector<int> input(100000);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = static_cast<int>(i);
+    }
+    ProcessConfig config;
+    config.concurrency = ConcurrencyPolicy::Parallel;
+    config.max_threads = 4;
+    
+    auto mapped = pipeline(input, config)
+        .map([](int x) { return x * 2; })
+        .map([](int x) { return std::to_string(x); })
+        .collect();
+    CHECK(mapped.success);
+    CHECK(mapped.results.size() == input.size());
+    CHECK(mapped.results[12345] == "24690");
+    
+    auto filtered = pipeline(input, config)
+        .map([](int x) { return x * 2; })
+        .filter([](const int& x) { return x % 3 == 0; })
+        .collect();
+    CHECK(filtered.success);
+    CHECK(filtered.results.size() == 33334);
+    bool ordered = true;
+    for (size_t i = 0; i < filtered.results.size(); ++i) {
+        ordered = ordered && filtered.results[i] == static_cast<int>(6 * i);
+    }
+    CHECK(ordered);
+}
+
+static void test_reduce() {
+    std::vector<int> input(100000);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = static_cast<int>(i);
+    }
+    ProcessConfig config;
+    config.concurrency = ConcurrencyPolicy::Parallel;
+    config.max_threads = 4;
+    
+    auto sum = pipeline(input, config)
+        .map([](int x) { return static_cast<long long>(x); })
+        .reduce(std::plus<>());
+    CHECK(sum.success);
+    CHECK(sum.value == 4999950000LL);
+    
+    auto evens = pipeline(input, config)
+        .filter([](const int& x) { return x % 2 == 0; })
+        .map([](int x) { return static_cast<long long>(x); })
+        .reduce(0LL, std::plus<>());
+    CHECK(evens.value == 2499950000LL);
+    
+    // Non-commutative combine: values must be combined in input order
+    std::vector<int> digits(1000);
+    for (size_t i = 0; i < digits.size(); ++i) {
+        digits[i] = static_cast<int>(i % 10);
+    }
+    auto text = pipeline(digits, config)
+        .map([](int d) { return std::string(1, static_cast<char>('0' + d)); })
+        .reduce(std::string(), std::plus<>());
+    std::string expected;
+    for (int d : digits) {
+        expected += static_cast<char>('0' + d);
+    }
+    CHECK(text.value == expected);
+}
+
+int main() {
+    test_collect();
+    test_reduce();
+    return check::report("test_pipeline");
+}